@@ -0,0 +1,332 @@
+// Runs the app's frame loop headless against the stand-ins in ../stubs: a loopback RenderStream that requests
+// frames as d3 would, and CPU versions of D3D11, Cuda events and the NvVFX SDK. Reports throughput, latency from
+// request to send, heap allocations and what the stand-ins were asked to do, so changes to the loop can be
+// measured without d3 or an RTX card.
+//
+// Usage: Benchmark [--name=value ...] [-- app options]
+
+// The app's main is renamed to renderStreamNvVFXMain when building its translation unit, see README.md
+#undef main
+
+#include "../stubs/Stubs.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+int renderStreamNvVFXMain(int argc, char** argv);
+
+namespace
+{
+    std::atomic<uint64_t> g_allocations{ 0 };
+    std::atomic<uint64_t> g_allocatedBytes{ 0 };
+}
+
+// Counts the app's allocations; the stand-ins' are left out, see StubHeapScope
+void* operator new(size_t size)
+{
+    if (stubHeapDepth() == 0)
+    {
+        ++g_allocations;
+        g_allocatedBytes += size;
+    }
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // These are the replacements for the matching operator new
+#endif
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+namespace
+{
+    struct Options
+    {
+        LoopbackScenario scenario;
+        std::chrono::microseconds effectTime{ 5000 }; // Inference time of every effect run
+        std::chrono::microseconds loadTime{ 0 }; // Model load time of every effect
+        bool check = false; // Fail the run unless it did what the scenario asked of the app
+        uint64_t mapsPerFrame = 0; // If set, the interop map and unmap calls every frame must make, for --check
+        int64_t loadsAfterStartup = -1; // If not negative, the effect loads the frames must make, for --check
+        std::vector<std::string> appArgs;
+    };
+
+    std::vector<std::string> split(const std::string& value, char separator)
+    {
+        std::vector<std::string> parts;
+        std::stringstream ss(value);
+        std::string part;
+        while (std::getline(ss, part, separator))
+            parts.push_back(part);
+        return parts;
+    }
+
+    LoopbackScenario::Size parseSize(const std::string& value)
+    {
+        const size_t x = value.find('x');
+        if (x == std::string::npos)
+            throw std::invalid_argument(value);
+        return { uint32_t(std::stoul(value.substr(0, x))), uint32_t(std::stoul(value.substr(x + 1))) };
+    }
+
+    RSPixelFormat parseFormat(const std::string& value)
+    {
+        if (value == "bgra8")
+            return RS_FMT_BGRA8;
+        if (value == "bgrx8")
+            return RS_FMT_BGRX8;
+        if (value == "rgba16")
+            return RS_FMT_RGBA16;
+        if (value == "rgba32f")
+            return RS_FMT_RGBA32F;
+        throw std::invalid_argument(value);
+    }
+
+    // Options are passed as --name=value, as they are to the app; anything after -- is passed to the app
+    Options parseOptions(int argc, char** argv)
+    {
+        Options options;
+        options.scenario.sizes = { { 1280, 720 } };
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if (arg == "--")
+            {
+                options.appArgs.assign(argv + i + 1, argv + argc);
+                break;
+            }
+            const size_t equals = arg.find('=');
+            const std::string name = arg.substr(0, equals);
+            const std::string value = equals == std::string::npos ? std::string() : arg.substr(equals + 1);
+            try
+            {
+                if (name == "--frames")
+                    options.scenario.frames = std::stoull(value);
+                else if (name == "--sizes")
+                {
+                    options.scenario.sizes.clear();
+                    for (const std::string& size : split(value, ','))
+                        options.scenario.sizes.push_back(parseSize(size));
+                }
+                else if (name == "--frames-per-size")
+                    options.scenario.framesPerSize = std::stoull(value);
+                else if (name == "--scenes")
+                {
+                    options.scenario.scenes.clear();
+                    for (const std::string& scene : split(value, ','))
+                        options.scenario.scenes.push_back(uint32_t(std::stoul(scene)));
+                }
+                else if (name == "--frames-per-scene")
+                    options.scenario.framesPerScene = std::stoull(value);
+                else if (name == "--frames-per-image")
+                    options.scenario.framesPerImage = std::stoull(value);
+                else if (name == "--frames-per-setting")
+                    options.scenario.framesPerSetting = std::stoull(value);
+                else if (name == "--streams")
+                    options.scenario.streams = uint32_t(std::stoul(value));
+                else if (name == "--stream-change-every")
+                    options.scenario.streamChangeEvery = std::stoull(value);
+                else if (name == "--consume-every")
+                    options.scenario.consumeEvery = std::stoull(value);
+                else if (name == "--stream-size")
+                    options.scenario.streamSize = parseSize(value);
+                else if (name == "--stream-format")
+                    options.scenario.streamFormat = parseFormat(value);
+                else if (name == "--image-format")
+                    options.scenario.imageFormat = parseFormat(value);
+                else if (name == "--outstanding")
+                    options.scenario.maxOutstanding = uint32_t(std::stoul(value));
+                else if (name == "--drop-after-ms")
+                    options.scenario.dropAfter = std::chrono::milliseconds(std::stoul(value));
+                else if (name == "--effect-ms")
+                    options.effectTime = std::chrono::microseconds(int64_t(std::stod(value) * 1000));
+                else if (name == "--load-ms")
+                    options.loadTime = std::chrono::microseconds(int64_t(std::stod(value) * 1000));
+                else if (name == "--verbose")
+                    options.scenario.verbose = true;
+                else if (name == "--check")
+                    options.check = true;
+                else if (name == "--maps-per-frame")
+                    options.mapsPerFrame = std::stoull(value);
+                else if (name == "--loads-after-startup")
+                    options.loadsAfterStartup = std::stoll(value);
+                else
+                    std::cerr << "Ignoring unknown option: " << arg << std::endl;
+            }
+            catch (const std::exception&)
+            {
+                std::cerr << "Ignoring invalid value for option: " << arg << std::endl;
+            }
+        }
+        return options;
+    }
+
+    double percentile(const std::vector<double>& sorted, double p)
+    {
+        if (sorted.empty())
+            return 0.;
+        return sorted[std::min(sorted.size() - 1, size_t(p / 100. * (sorted.size() - 1) + 0.5))];
+    }
+
+    // Buckets of doubling width from 1ms, with everything under 1ms in the first
+    void printHistogram(const std::vector<double>& latencies)
+    {
+        std::vector<uint64_t> buckets;
+        for (double ms : latencies)
+        {
+            size_t bucket = 0;
+            for (double limit = 1.; ms >= limit; limit *= 2.)
+                ++bucket;
+            if (bucket >= buckets.size())
+                buckets.resize(bucket + 1);
+            ++buckets[bucket];
+        }
+        const uint64_t largest = buckets.empty() ? 1 : *std::max_element(buckets.begin(), buckets.end());
+        double lower = 0., upper = 1.;
+        for (uint64_t count : buckets)
+        {
+            char label[32];
+            std::snprintf(label, sizeof(label), "%7.0f - %-5.0f ms", lower, upper);
+            std::printf("  %s %8llu %s\n", label, (unsigned long long)count, std::string(size_t(40 * count / largest), '#').c_str());
+            lower = upper;
+            upper *= 2.;
+        }
+    }
+
+    struct Snapshot
+    {
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+        uint64_t texturesCreated = 0;
+        uint64_t imagesAllocated = 0;
+        uint64_t effectLoads = 0;
+        uint64_t mapCalls = 0;
+        uint64_t unmapCalls = 0;
+
+        static Snapshot take()
+        {
+            Snapshot snapshot;
+            snapshot.allocations = g_allocations;
+            snapshot.allocatedBytes = g_allocatedBytes;
+            snapshot.texturesCreated = stubCounters().texturesCreated;
+            snapshot.imagesAllocated = stubCounters().imagesAllocated;
+            snapshot.effectLoads = stubCounters().effectLoads;
+            snapshot.mapCalls = stubCounters().mapCalls;
+            snapshot.unmapCalls = stubCounters().unmapCalls;
+            return snapshot;
+        }
+    };
+}
+
+int main(int argc, char** argv)
+{
+    Options options = parseOptions(argc, argv);
+
+    // Startup (effect creation, loading and warm up) is left out of the steady state figures
+    Snapshot startup;
+    options.scenario.onFirstFrame = [&]() { startup = Snapshot::take(); };
+    loopbackConfigure(options.scenario);
+    nvvfxStubSetDelays(options.effectTime, options.loadTime);
+
+    std::vector<std::string> args = { "RenderStreamNvVFX" };
+    args.insert(args.end(), options.appArgs.begin(), options.appArgs.end());
+    std::vector<char*> appArgv;
+    for (std::string& arg : args)
+        appArgv.push_back(&arg[0]);
+    appArgv.push_back(nullptr);
+
+    const int result = renderStreamNvVFXMain(int(args.size()), appArgv.data());
+    const Snapshot end = Snapshot::take();
+    const LoopbackResults& results = loopbackResults();
+    const StubCounters& counters = stubCounters();
+
+    std::printf("\nScenario: %llu frames, %zu size(s), %zu scene(s), %u stream(s), %u outstanding, %.1f ms effects\n",
+        (unsigned long long)options.scenario.frames, options.scenario.sizes.size(), options.scenario.scenes.size(),
+        options.scenario.streams, options.scenario.maxOutstanding, options.effectTime.count() / 1000.);
+    std::printf("App returned %d, last status: %s\n\n", result, results.status.c_str());
+
+    const double seconds = results.completed ? std::chrono::duration<double>(results.lastCompletion - results.firstRequest).count() : 0.;
+    std::printf("Frames: %llu requested, %llu completed, %llu dropped, %llu sends, %llu messages logged\n",
+        (unsigned long long)results.requested, (unsigned long long)results.completed, (unsigned long long)results.dropped,
+        (unsigned long long)results.sends, (unsigned long long)results.logMessages);
+    std::printf("Throughput: %.1f frames/s over %.2f s\n\n", seconds > 0. ? results.completed / seconds : 0., seconds);
+
+    std::vector<double> latencies = results.latencyMs;
+    std::sort(latencies.begin(), latencies.end());
+    double mean = 0.;
+    for (double ms : latencies)
+        mean += ms / latencies.size();
+    std::printf("Latency (ms): mean %.2f, p50 %.2f, p95 %.2f, p99 %.2f, max %.2f\n", mean, percentile(latencies, 50),
+        percentile(latencies, 95), percentile(latencies, 99), latencies.empty() ? 0. : latencies.back());
+    printHistogram(latencies);
+
+    const uint64_t steadyFrames = std::max<uint64_t>(results.completed, 1);
+    std::printf("\nHeap allocations: %llu at startup, %llu after (%.1f per frame, %.1f KB per frame)\n",
+        (unsigned long long)startup.allocations, (unsigned long long)(end.allocations - startup.allocations),
+        double(end.allocations - startup.allocations) / steadyFrames, double(end.allocatedBytes - startup.allocatedBytes) / 1024. / steadyFrames);
+    std::printf("Textures created: %llu at startup, %llu after (%.1f MB in all)\n", (unsigned long long)startup.texturesCreated,
+        (unsigned long long)(end.texturesCreated - startup.texturesCreated), counters.textureBytes / 1048576.);
+    std::printf("NvCVImage buffers: %llu at startup, %llu after (%.1f MB in all)\n", (unsigned long long)startup.imagesAllocated,
+        (unsigned long long)(end.imagesAllocated - startup.imagesAllocated), counters.imageBytes / 1048576.);
+    std::printf("Effect loads: %llu at startup, %llu after\n", (unsigned long long)startup.effectLoads, (unsigned long long)(end.effectLoads - startup.effectLoads));
+    std::printf("Effect runs %llu, transfers %llu, maps %llu, unmaps %llu, draws %llu, dispatches %llu\n", (unsigned long long)counters.effectRuns.load(),
+        (unsigned long long)counters.transfers.load(), (unsigned long long)counters.mapCalls.load(), (unsigned long long)counters.unmapCalls.load(),
+        (unsigned long long)counters.draws.load(), (unsigned long long)counters.dispatches.load());
+    const uint64_t steadyMaps = end.mapCalls - startup.mapCalls;
+    const uint64_t steadyUnmaps = end.unmapCalls - startup.unmapCalls;
+    std::printf("Interop: %.2f map calls and %.2f unmap calls per frame after startup, mapping %.2f resources per frame in all\n",
+        double(steadyMaps) / steadyFrames, double(steadyUnmaps) / steadyFrames, double(counters.mappedResources) / steadyFrames);
+
+    if (!results.profiling.empty())
+    {
+        std::printf("\nLast profiling data sent to d3:\n");
+        for (const auto& [name, value] : results.profiling)
+            std::printf("  %-28s %8.3f\n", name.c_str(), value);
+    }
+
+    if (result != 0)
+        return result;
+
+    // Checks the scenario needs the app to pass, rather than figures to compare between runs
+    if (options.check)
+    {
+        std::vector<std::string> failures;
+        if (results.completed != results.requested || results.dropped)
+            failures.push_back("every frame requested was sent to every stream");
+        // Only scenes with live settings load their effect again
+        if (options.scenario.framesPerSetting && results.requested > options.scenario.framesPerSetting && end.effectLoads == startup.effectLoads)
+            failures.push_back("changing settings loaded effects again");
+        // Each interop batch a frame uses is mapped with one call and unmapped with one, however many resources it has
+        if (options.mapsPerFrame && (steadyMaps != options.mapsPerFrame * results.completed || steadyUnmaps != options.mapsPerFrame * results.completed))
+            failures.push_back("every frame made " + std::to_string(options.mapsPerFrame) + " interop map calls and as many unmap calls");
+        // Effects warmed up at startup for the size and scale the frames run at never load again for them
+        if (options.loadsAfterStartup >= 0 && end.effectLoads - startup.effectLoads != uint64_t(options.loadsAfterStartup))
+            failures.push_back("effects were loaded " + std::to_string(options.loadsAfterStartup) + " times after startup");
+        for (const std::string& failure : failures)
+            std::printf("Check failed: %s\n", failure.c_str());
+        if (!failures.empty())
+            return 1;
+        std::printf("\nChecks passed\n");
+    }
+    return results.completed > 0 ? 0 : 1;
+}
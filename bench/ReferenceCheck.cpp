@@ -0,0 +1,282 @@
+// Checks the CPU references the stand-ins run in place of the shaders against straightforward transcriptions of
+// the shaders' arithmetic, a pixel at a time, over widths that leave every SIMD path a remainder. Conversions must
+// match bit for bit, the guided filter to within float rounding, as it sums in a different order.
+//
+// Usage: ReferenceCheck, exits 1 if any check fails
+
+#include "../stubs/GuidedFilter.h"
+#include "../stubs/PixelConversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const uint32_t WIDTHS[] = { 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 33, 67 };
+    const uint32_t HEIGHT = 5;
+    const size_t PADDING = 12; // Bytes at the end of every row, so pitches aren't the width
+    const uint32_t MAX_RADIUS = 4; // Of MatteShader.hlsl
+    const float EPSILON = 1e-3f; // The app's
+    const float TOLERANCE = 1e-4f; // Of the guided filter, relative to the larger of 1 and the expected value
+
+    std::vector<std::string> g_failures;
+
+    void fail(const std::string& what, uint32_t width, uint32_t x, uint32_t y)
+    {
+        g_failures.push_back(what + " at " + std::to_string(x) + ", " + std::to_string(y) + " of width " + std::to_string(width));
+    }
+
+    template <typename T>
+    T* row(T* base, size_t pitch, size_t y)
+    {
+        return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(base) + y * pitch);
+    }
+
+    // UNORM to float, as D3D converts a texel when InputShader.hlsl loads it
+    float shaderUnormToFloat(uint8_t c)
+    {
+        return float(c) / 255.f;
+    }
+
+    // Float to UNORM, as D3D converts what the pixel shader writes: saturate, NaN to 0, then round to nearest even
+    uint8_t shaderFloatToUnorm(float f)
+    {
+        const float saturated = std::isnan(f) ? 0.f : std::min(std::max(f, 0.f), 1.f);
+        return uint8_t(std::nearbyint(saturated * 255.f));
+    }
+
+    // Floats the pixel shader might be given: anything in and around [0, 1], values that round to even, and the
+    // ones saturation has to catch
+    float planarValue(std::mt19937& random, size_t i)
+    {
+        static const float SPECIAL[] = { 0.f, -0.f, 1.f, -1.f, 2.f, std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(),
+            -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::denorm_min(), 0.5f / 255.f, 1.5f / 255.f, 254.5f / 255.f };
+        if (i % 5 == 0)
+            return SPECIAL[(i / 5) % (sizeof(SPECIAL) / sizeof(SPECIAL[0]))];
+        if (i % 5 == 1)
+            return (float(random() % 256) + 0.5f) / 255.f;
+        return std::uniform_real_distribution<float>(-0.25f, 1.25f)(random);
+    }
+
+    bool close(float value, float expected)
+    {
+        return std::fabs(value - expected) <= TOLERANCE * std::max(1.f, std::fabs(expected));
+    }
+
+    // The coefficients MatteShader.hlsl writes for (x), (y): a and b of every pixel in its window, averaged, where a
+    // and b come from the means of the guide I and matte p over their own windows, all clipped to the image
+    void shaderCoefficients(const std::vector<float>& guide, const std::vector<uint8_t>& matte, uint32_t width, uint32_t height, uint32_t radius,
+        uint32_t x, uint32_t y, float& a, float& b)
+    {
+        const auto filter = [&](uint32_t cx, uint32_t cy, float& fa, float& fb)
+        {
+            float sums[4] = {};
+            float count = 0.f;
+            for (uint32_t wy = cy > radius ? cy - radius : 0; wy <= std::min(cy + radius, height - 1); ++wy)
+            {
+                for (uint32_t wx = cx > radius ? cx - radius : 0; wx <= std::min(cx + radius, width - 1); ++wx)
+                {
+                    const float i = guide[size_t(wy) * width + wx];
+                    const float p = matte[size_t(wy) * width + wx] / 255.f;
+                    sums[0] += i;
+                    sums[1] += p;
+                    sums[2] += i * i;
+                    sums[3] += i * p;
+                    count += 1.f;
+                }
+            }
+            const float meanI = sums[0] / count, meanP = sums[1] / count, meanII = sums[2] / count, meanIP = sums[3] / count;
+            fa = (meanIP - meanI * meanP) / (meanII - meanI * meanI + EPSILON);
+            fb = meanP - fa * meanI;
+        };
+        float sumA = 0.f, sumB = 0.f, count = 0.f;
+        for (uint32_t wy = y > radius ? y - radius : 0; wy <= std::min(y + radius, height - 1); ++wy)
+        {
+            for (uint32_t wx = x > radius ? x - radius : 0; wx <= std::min(x + radius, width - 1); ++wx)
+            {
+                float fa, fb;
+                filter(wx, wy, fa, fb);
+                sumA += fa;
+                sumB += fb;
+                count += 1.f;
+            }
+        }
+        a = sumA / count;
+        b = sumB / count;
+    }
+
+    // The matte technique 3 of the output shaders draws at (x), (y) of the input: the coefficients sampled bilinearly
+    // at the pixel's centre, clamped to their edges, applied to the input's luma and saturated
+    float shaderRefinedMatte(const std::vector<float>& coefficients, uint32_t width, uint32_t height, const std::vector<uint8_t>& input,
+        uint32_t inputWidth, uint32_t inputHeight, uint32_t x, uint32_t y)
+    {
+        const float u = (float(x) + 0.5f) / float(inputWidth) * float(width) - 0.5f;
+        const float v = (float(y) + 0.5f) / float(inputHeight) * float(height) - 0.5f;
+        const int64_t left = int64_t(std::floor(u)), top = int64_t(std::floor(v));
+        const float fu = u - std::floor(u), fv = v - std::floor(v);
+        const auto at = [&](int64_t cx, int64_t cy, int component)
+        {
+            return coefficients[(size_t(std::clamp<int64_t>(cy, 0, height - 1)) * width + size_t(std::clamp<int64_t>(cx, 0, width - 1))) * 2 + component];
+        };
+        float sampled[2];
+        for (int c = 0; c < 2; ++c)
+        {
+            const float upper = at(left, top, c) + (at(left + 1, top, c) - at(left, top, c)) * fu;
+            const float lower = at(left, top + 1, c) + (at(left + 1, top + 1, c) - at(left, top + 1, c)) * fu;
+            sampled[c] = upper + (lower - upper) * fv;
+        }
+        const uint8_t* pixel = &input[(size_t(y) * inputWidth + x) * 4];
+        const float refined = sampled[0] * guideLuma(pixel[2] / 255.f, pixel[1] / 255.f, pixel[0] / 255.f) + sampled[1];
+        return std::isnan(refined) ? 0.f : std::min(std::max(refined, 0.f), 1.f);
+    }
+
+    // A guide of soft shapes with noise on them, and a matte that roughly but not quite follows their edges
+    void checkGuidedFilter(std::mt19937& random, uint32_t width, uint32_t radius)
+    {
+        const uint32_t height = HEIGHT + radius;
+        std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+        std::vector<float> guide(size_t(width) * height);
+        std::vector<uint8_t> matte(size_t(width) * height);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const bool inside = (x * 3 + y * 5) % 11 < 6;
+                guide[size_t(y) * width + x] = std::min(std::max((inside ? 0.8f : 0.2f) + noise(random), 0.f), 1.f);
+                matte[size_t(y) * width + x] = uint8_t((inside != (random() % 8 == 0)) ? 255 - random() % 32 : random() % 32);
+            }
+        }
+
+        // Copies with padding, to the pitches the stand-in uses
+        const size_t guidePitch = width * sizeof(float) + PADDING, mattePitch = width + PADDING, coefficientsPitch = width * 2 * sizeof(float) + PADDING;
+        std::vector<uint8_t> guideRows(guidePitch * height), matteRows(mattePitch * height), coefficientRows(coefficientsPitch * height);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            std::memcpy(row(guideRows.data(), guidePitch, y), &guide[size_t(y) * width], width * sizeof(float));
+            std::memcpy(row(matteRows.data(), mattePitch, y), &matte[size_t(y) * width], width);
+        }
+        guidedFilterCoefficients(reinterpret_cast<const float*>(guideRows.data()), guidePitch, matteRows.data(), mattePitch,
+            reinterpret_cast<float*>(coefficientRows.data()), coefficientsPitch, width, height, radius, EPSILON);
+
+        std::vector<float> coefficients(size_t(width) * height * 2);
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const float* out = row(reinterpret_cast<const float*>(coefficientRows.data()), coefficientsPitch, y);
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                float a, b;
+                shaderCoefficients(guide, matte, width, height, radius, x, y, a, b);
+                if (!close(out[x * 2], a) || !close(out[x * 2 + 1], b))
+                    fail("Guided filter coefficients differ from MatteShader.hlsl with radius " + std::to_string(radius), width, x, y);
+                coefficients[(size_t(y) * width + x) * 2] = out[x * 2];
+                coefficients[(size_t(y) * width + x) * 2 + 1] = out[x * 2 + 1];
+            }
+        }
+
+        // Refined at the size of the matte and at twice and three times it, as for mattes at a half or a third
+        for (uint32_t factor = 1; factor <= 3; ++factor)
+        {
+            const uint32_t inputWidth = width * factor, inputHeight = height * factor;
+            std::vector<uint8_t> input(size_t(inputWidth) * inputHeight * 4);
+            for (uint8_t& c : input)
+                c = uint8_t(random());
+            const size_t refinedPitch = inputWidth * sizeof(float) + PADDING;
+            std::vector<uint8_t> refined(refinedPitch * inputHeight);
+            guidedFilterUpsample(coefficients.data(), width * 2 * sizeof(float), width, height, input.data(), size_t(inputWidth) * 4,
+                reinterpret_cast<float*>(refined.data()), refinedPitch, inputWidth, inputHeight);
+            for (uint32_t y = 0; y < inputHeight; ++y)
+            {
+                const float* out = row(reinterpret_cast<const float*>(refined.data()), refinedPitch, y);
+                for (uint32_t x = 0; x < inputWidth; ++x)
+                {
+                    if (!close(out[x], shaderRefinedMatte(coefficients, width, height, input, inputWidth, inputHeight, x, y)))
+                        fail("Refined matte differs from the output shaders at " + std::to_string(factor) + " times the size", width, x, y);
+                }
+            }
+        }
+    }
+
+    void checkBgra8ToPlanarF32(std::mt19937& random, uint32_t width)
+    {
+        const size_t srcPitch = width * 4 + PADDING;
+        const size_t dstPitch = width * sizeof(float) + PADDING;
+        std::vector<uint8_t> src(srcPitch * HEIGHT);
+        for (uint8_t& c : src)
+            c = uint8_t(random());
+        std::vector<uint8_t> dst(dstPitch * HEIGHT * 3);
+        bgra8ToPlanarF32(src.data(), srcPitch, reinterpret_cast<float*>(dst.data()), dstPitch, width, HEIGHT);
+
+        for (uint32_t y = 0; y < HEIGHT; ++y)
+        {
+            const uint8_t* in = row(src.data(), srcPitch, y);
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                for (uint32_t plane = 0; plane < 3; ++plane)
+                {
+                    const float expected = shaderUnormToFloat(in[x * 4 + plane]); // B, G then R
+                    if (std::memcmp(&row(reinterpret_cast<const float*>(dst.data()), dstPitch, y + plane * HEIGHT)[x], &expected, sizeof(float)) != 0)
+                        fail("BGRA8 to planar F32 differs from InputShader.hlsl", width, x, y);
+                }
+            }
+        }
+    }
+
+    void checkPlanarF32ToBgra8(std::mt19937& random, uint32_t width)
+    {
+        const size_t srcPitch = width * sizeof(float) + PADDING;
+        const size_t dstPitch = width * 4 + PADDING;
+        std::vector<uint8_t> src(srcPitch * HEIGHT * 3);
+        size_t i = 0;
+        for (uint32_t y = 0; y < HEIGHT * 3; ++y)
+        {
+            for (uint32_t x = 0; x < width; ++x)
+                row(reinterpret_cast<float*>(src.data()), srcPitch, y)[x] = planarValue(random, i++);
+        }
+        std::vector<uint8_t> dst(dstPitch * HEIGHT);
+        planarF32ToBgra8(reinterpret_cast<const float*>(src.data()), srcPitch, dst.data(), dstPitch, width, HEIGHT);
+
+        for (uint32_t y = 0; y < HEIGHT; ++y)
+        {
+            const uint8_t* out = row(dst.data(), dstPitch, y);
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                for (uint32_t plane = 0; plane < 3; ++plane)
+                {
+                    if (out[x * 4 + plane] != shaderFloatToUnorm(row(reinterpret_cast<const float*>(src.data()), srcPitch, y + plane * HEIGHT)[x]))
+                        fail("Planar F32 to BGRA8 differs from the pixel shader", width, x, y);
+                }
+                if (out[x * 4 + 3] != 0xff)
+                    fail("Planar F32 to BGRA8 left alpha short of opaque", width, x, y);
+            }
+        }
+    }
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    for (uint32_t width : WIDTHS)
+    {
+        checkBgra8ToPlanarF32(random, width);
+        checkPlanarF32ToBgra8(random, width);
+        for (uint32_t radius = 0; radius <= MAX_RADIUS; ++radius)
+            checkGuidedFilter(random, width, radius);
+    }
+
+    std::printf("Pixel conversions: %s\n", pixelConversionInstructionSet());
+    for (size_t i = 0; i < std::min<size_t>(g_failures.size(), 20); ++i)
+        std::printf("Check failed: %s\n", g_failures[i].c_str());
+    if (!g_failures.empty())
+    {
+        std::printf("%zu checks failed\n", g_failures.size());
+        return 1;
+    }
+    std::printf("Checks passed\n");
+    return 0;
+}
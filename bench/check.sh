@@ -0,0 +1,49 @@
+#!/bin/sh
+# Builds the benchmark and runs it with --check over the scenarios below, after checking the CPU references the
+# stand-ins run, failing if any of them fails or hangs.
+#
+# Usage: bench/check.sh [build directory], from the root of the repository. CXX picks the compiler, default g++.
+
+set -e
+
+BUILD=${1:-build}
+CXX=${CXX:-g++}
+mkdir -p "$BUILD"
+
+$CXX -std=c++17 -O2 -Dmain=renderStreamNvVFXMain -Istubs/win32 src/RenderStreamNvVFX.cpp stubs/*.cpp bench/Benchmark.cpp -lpthread -o "$BUILD/Benchmark"
+$CXX -std=c++17 -O2 stubs/PixelConversion.cpp stubs/GuidedFilter.cpp bench/ReferenceCheck.cpp -o "$BUILD/ReferenceCheck"
+
+failed=0
+# The CPU references the stand-ins run against the shaders' arithmetic
+echo "== ReferenceCheck"
+if ! "$BUILD/ReferenceCheck" > "$BUILD/check.log" 2>&1; then
+    cat "$BUILD/check.log"
+    echo "== FAILED: ReferenceCheck"
+    failed=1
+fi
+
+scenario()
+{
+    echo "== Benchmark $*"
+    if ! timeout 300 "$BUILD/Benchmark" --check "$@" > "$BUILD/check.log" 2>&1; then
+        cat "$BUILD/check.log"
+        echo "== FAILED: Benchmark $*"
+        failed=1
+    fi
+}
+
+# Every scene, back to back
+scenario --frames=200 --scenes=0,1,2,3,4,5,6,7 --sizes=640x360 --effect-ms=1
+# Settings changing under frames in flight, with and without the replacement instances taking time to load
+scenario --frames=60 --scenes=1 --sizes=640x360 --frames-per-setting=10
+scenario --frames=60 --scenes=1 --sizes=640x360 --frames-per-setting=10 --load-ms=30
+scenario --frames=120 --scenes=1,2,3,6,7 --sizes=640x360 --effect-ms=1 --frames-per-setting=20 --load-ms=10 -- --instances=2
+# Background blur segments with Green screen instances of its own, so Green screen running at another size takes
+# nothing from it, and neither drops frames or loads again
+scenario --frames=200 --scenes=1,5 --sizes=640x360 --effect-ms=1 --load-ms=50 --loads-after-startup=0 -- --matte-divisor=2
+# A frame maps its input with one call and its outputs with another, and unmaps them likewise
+scenario --frames=100 --scenes=0,1,2,3 --sizes=640x360 --effect-ms=1 --maps-per-frame=2
+# Effects are warmed up at startup for the size and scale frames as large as the stream run at, scaling up or not
+scenario --frames=100 --scenes=0,1,2,3,4,5,6,7 --sizes=640x360 --effect-ms=1 --loads-after-startup=0
+
+exit $failed
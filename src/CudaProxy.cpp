@@ -0,0 +1,121 @@
+#include "CudaProxy.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static HMODULE getCudaLib()
+{
+    static const HMODULE cudaLib = LoadLibrary(TEXT("nvcuda.dll"));
+    return cudaLib;
+}
+
+template <typename Func>
+static Func* getCudaProc(const char* name)
+{
+    const HMODULE cudaLib = getCudaLib();
+    return cudaLib ? reinterpret_cast<Func*>(GetProcAddress(cudaLib, name)) : nullptr;
+}
+
+CUresult cuEventCreate(CUevent* event, unsigned int flags)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuEventCreate)>("cuEventCreate");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(event, flags);
+}
+
+CUresult cuEventDestroy(CUevent event)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuEventDestroy)>("cuEventDestroy_v2");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(event);
+}
+
+CUresult cuEventRecord(CUevent event, CUstream stream)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuEventRecord)>("cuEventRecord");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(event, stream);
+}
+
+CUresult cuEventQuery(CUevent event)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuEventQuery)>("cuEventQuery");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(event);
+}
+
+CUresult cuEventSynchronize(CUevent event)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuEventSynchronize)>("cuEventSynchronize");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(event);
+}
+
+CUresult cuEventElapsedTime(float* milliseconds, CUevent start, CUevent end)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuEventElapsedTime)>("cuEventElapsedTime");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(milliseconds, start, end);
+}
+
+CUresult cuStreamWaitEvent(CUstream stream, CUevent event, unsigned int flags)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuStreamWaitEvent)>("cuStreamWaitEvent");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(stream, event, flags);
+}
+
+CUresult cuGraphicsD3D11RegisterResource(CUgraphicsResource* resource, struct ID3D11Resource* d3dResource, unsigned int flags)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuGraphicsD3D11RegisterResource)>("cuGraphicsD3D11RegisterResource");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(resource, d3dResource, flags);
+}
+
+CUresult cuGraphicsUnregisterResource(CUgraphicsResource resource)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuGraphicsUnregisterResource)>("cuGraphicsUnregisterResource");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(resource);
+}
+
+CUresult cuGraphicsMapResources(unsigned int count, CUgraphicsResource* resources, CUstream stream)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuGraphicsMapResources)>("cuGraphicsMapResources");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(count, resources, stream);
+}
+
+CUresult cuGraphicsUnmapResources(unsigned int count, CUgraphicsResource* resources, CUstream stream)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuGraphicsUnmapResources)>("cuGraphicsUnmapResources");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(count, resources, stream);
+}
+
+CUresult cuGraphicsSubResourceGetMappedArray(CUarray* array, CUgraphicsResource resource, unsigned int arrayIndex, unsigned int mipLevel)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuGraphicsSubResourceGetMappedArray)>("cuGraphicsSubResourceGetMappedArray");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(array, resource, arrayIndex, mipLevel);
+}
+
+CUresult cuGraphicsResourceGetMappedPointer(CUdeviceptr* pointer, size_t* size, CUgraphicsResource resource)
+{
+    static const auto funcPtr = getCudaProc<decltype(cuGraphicsResourceGetMappedPointer)>("cuGraphicsResourceGetMappedPointer_v2");
+
+    if (nullptr == funcPtr) return CUDA_ERROR_NOT_INITIALIZED;
+    return funcPtr(pointer, size, resource);
+}
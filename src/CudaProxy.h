@@ -0,0 +1,70 @@
+// The subset of the CUDA driver API used to track frame completion and to share D3D11 textures with the
+// effects, loaded from nvcuda.dll at runtime in the same way as the NvVFX and NvCVImage entry points so
+// the app doesn't need the CUDA toolkit.
+//
+// The driver API calls use the context current on the calling thread; the NvVFX SDK uses the CUDA
+// runtime, which makes the device's primary context current on the thread that creates the Cuda stream.
+
+#pragma once
+
+#include "../nvvfx/include/nvVideoEffects.h" // for CUstream
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct CUevent_st* CUevent;
+typedef struct CUgraphicsResource_st* CUgraphicsResource;
+typedef struct CUarray_st* CUarray;
+typedef unsigned long long CUdeviceptr;
+struct ID3D11Resource;
+
+typedef enum CUresult
+{
+    CUDA_SUCCESS = 0,
+    CUDA_ERROR_INVALID_VALUE = 1,
+    CUDA_ERROR_NOT_INITIALIZED = 3,
+    CUDA_ERROR_ALREADY_MAPPED = 208,
+    CUDA_ERROR_NOT_MAPPED = 211,
+    CUDA_ERROR_INVALID_HANDLE = 400,
+    CUDA_ERROR_NOT_FOUND = 500,
+    CUDA_ERROR_NOT_READY = 600,
+} CUresult;
+
+typedef enum CUevent_flags
+{
+    CU_EVENT_DEFAULT = 0x0,
+    CU_EVENT_BLOCKING_SYNC = 0x1,
+    CU_EVENT_DISABLE_TIMING = 0x2,
+} CUevent_flags;
+
+typedef enum CUgraphicsRegisterFlags
+{
+    CU_GRAPHICS_REGISTER_FLAGS_NONE = 0x0,
+} CUgraphicsRegisterFlags;
+
+CUresult cuEventCreate(CUevent* event, unsigned int flags);
+CUresult cuEventDestroy(CUevent event);
+CUresult cuEventRecord(CUevent event, CUstream stream);
+// Returns CUDA_SUCCESS if all work captured by the event has completed, CUDA_ERROR_NOT_READY if not
+CUresult cuEventQuery(CUevent event);
+CUresult cuEventSynchronize(CUevent event);
+// Milliseconds between two completed events, neither created with CU_EVENT_DISABLE_TIMING
+CUresult cuEventElapsedTime(float* milliseconds, CUevent start, CUevent end);
+// Work queued on (stream) after this waits for the work (event) was last recorded after, which can be on another stream
+CUresult cuStreamWaitEvent(CUstream stream, CUevent event, unsigned int flags);
+
+// Registration is done once per texture; mapping is done for as many registered resources as are passed at once,
+// and orders the stream after D3D's use of them, as unmapping orders D3D after the stream's
+CUresult cuGraphicsD3D11RegisterResource(CUgraphicsResource* resource, struct ID3D11Resource* d3dResource, unsigned int flags);
+CUresult cuGraphicsUnregisterResource(CUgraphicsResource resource);
+CUresult cuGraphicsMapResources(unsigned int count, CUgraphicsResource* resources, CUstream stream);
+CUresult cuGraphicsUnmapResources(unsigned int count, CUgraphicsResource* resources, CUstream stream);
+// The array a mapped texture can be accessed through until it is unmapped
+CUresult cuGraphicsSubResourceGetMappedArray(CUarray* array, CUgraphicsResource resource, unsigned int arrayIndex, unsigned int mipLevel);
+// Likewise the memory of a mapped buffer, which may be at a different address each time it is mapped
+CUresult cuGraphicsResourceGetMappedPointer(CUdeviceptr* pointer, size_t* size, CUgraphicsResource resource);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
@@ -0,0 +1,138 @@
+// Times the stages of each frame and keeps the most recent timings of every stage, so their percentiles
+// can be pushed to d3 with rs_sendProfilingData every frame. That shows whether dropped frames come
+// from inference or from moving images around.
+//
+// Stage is an enum whose values count up from 0 to Stage::Count. Times are in milliseconds; a stage that
+// runs several times in a frame (drawing for each stream, say) records the total for the frame. Frames
+// overlap while they are in flight, so each keeps its own Timings and commits them once it is finished,
+// and a sample never mixes the stages of different frames.
+
+#pragma once
+
+#include "../renderstream/d3renderstream.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <vector>
+
+template <typename Stage>
+class FrameProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // (names) are the display names of the stages, in order. (window) is how many frames the percentiles cover.
+    FrameProfiler(const std::vector<std::string>& names, size_t window)
+        : m_window(std::max<size_t>(window, 1))
+        , m_stages(size_t(Stage::Count))
+    {
+        for (size_t i = 0; i < m_stages.size(); ++i)
+        {
+            m_stages[i].name = i < names.size() ? names[i] : std::to_string(i);
+            for (const Percentile& percentile : PERCENTILES)
+                m_stages[i].entryNames.push_back(m_stages[i].name + " " + percentile.suffix + " (ms)");
+        }
+    }
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // The stages one frame has been through so far, kept with the frame until it is committed
+    class Timings
+    {
+    public:
+        void record(Stage stage, double milliseconds)
+        {
+            m_totals[size_t(stage)] += milliseconds;
+            m_recorded[size_t(stage)] = true;
+        }
+
+        // Records the time since (start)
+        void record(Stage stage, Clock::time_point start)
+        {
+            record(stage, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+
+        void clear()
+        {
+            m_totals.fill(0);
+            m_recorded.fill(false);
+        }
+
+    private:
+        friend class FrameProfiler;
+
+        std::array<double, size_t(Stage::Count)> m_totals{};
+        std::array<bool, size_t(Stage::Count)> m_recorded{};
+    };
+
+    // Adds the total of every stage recorded in (timings) to that stage's window, and clears them for the next frame
+    void commit(Timings& timings)
+    {
+        for (size_t i = 0; i < m_stages.size(); ++i)
+        {
+            if (!timings.m_recorded[i])
+                continue;
+            StageTimings& stage = m_stages[i];
+            if (stage.samples.size() < m_window)
+                stage.samples.push_back(timings.m_totals[i]);
+            else
+                stage.samples[stage.next] = timings.m_totals[i];
+            stage.next = (stage.next + 1) % m_window;
+            m_committed = true;
+        }
+        timings.clear();
+    }
+
+    // Whether anything has been committed since the last call, so the percentiles may have changed
+    bool takeCommitted()
+    {
+        const bool committed = m_committed;
+        m_committed = false;
+        return committed;
+    }
+
+    // The percentiles of every stage that has been recorded, named "<stage> p50 (ms)" and so on. Valid until the next call.
+    std::vector<ProfilingEntry>& entries()
+    {
+        m_entries.clear();
+        for (StageTimings& timings : m_stages)
+        {
+            if (timings.samples.empty())
+                continue;
+            m_sorted = timings.samples;
+            for (size_t i = 0; i < std::size(PERCENTILES); ++i)
+            {
+                const auto nth = m_sorted.begin() + size_t(PERCENTILES[i].fraction * (m_sorted.size() - 1) + 0.5);
+                std::nth_element(m_sorted.begin(), nth, m_sorted.end());
+                m_entries.push_back({ timings.entryNames[i].c_str(), float(*nth) });
+            }
+        }
+        return m_entries;
+    }
+
+private:
+    struct Percentile
+    {
+        const char* suffix;
+        double fraction;
+    };
+    static constexpr Percentile PERCENTILES[] = { { "p50", 0.5 }, { "p95", 0.95 }, { "p99", 0.99 } };
+
+    struct StageTimings
+    {
+        std::string name;
+        std::vector<std::string> entryNames; // One per percentile, kept alive for the entries
+        std::vector<double> samples; // Ring of the last (window) frames that recorded this stage
+        size_t next = 0;
+    };
+
+    size_t m_window;
+    std::vector<StageTimings> m_stages;
+    bool m_committed = false;
+    std::vector<double> m_sorted;
+    std::vector<ProfilingEntry> m_entries;
+};
@@ -0,0 +1,68 @@
+// Converts an input texture into an effect's input layout, written to a raw buffer that Cuda maps as linear memory
+// so the effect takes it as it is, with no copy in between. Planar layouts are the B, G and R planes one above the
+// other as floats, chunky ones 8 bit components packed in (components) per pixel, in BGR(A) or RGB(A) order. An
+// input larger than the effect size is scaled down to it as it is converted.
+
+cbuffer InputLayout : register(b0)
+{
+    uint width; // Of the effect input
+    uint height;
+    uint pitch; // Bytes from one row to the next
+    uint offset; // Bytes to the first row, for the images of a batch after the first
+    uint planar;
+    uint components; // Per pixel, of chunky layouts
+    uint redFirst; // Of chunky layouts, RGB(A) rather than BGR(A)
+};
+
+Texture2D<float4> input : register(t0);
+RWByteAddressBuffer output : register(u0);
+SamplerState ss : register(s0); // Left unbound for the default, linear and clamped
+
+float4 colourAt(uint2 xy)
+{
+    uint inputWidth, inputHeight;
+    input.GetDimensions(inputWidth, inputHeight);
+    if (width == inputWidth && height == inputHeight)
+        return input.Load(int3(xy, 0));
+    return input.SampleLevel(ss, (float2(xy) + 0.5) / float2(width, height), 0);
+}
+
+// Planar layouts take a thread per pixel, chunky ones a thread per 32 bit word of a row
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    if (id.y >= height)
+        return;
+
+    if (planar)
+    {
+        if (id.x >= width)
+            return;
+        const float4 colour = colourAt(id.xy);
+        const uint address = offset + id.y * pitch + id.x * 4;
+        output.Store(address, asuint(colour.b));
+        output.Store(address + height * pitch, asuint(colour.g));
+        output.Store(address + 2 * height * pitch, asuint(colour.r));
+        return;
+    }
+
+    const uint rowBytes = width * components;
+    const uint first = id.x * 4;
+    if (first >= rowBytes)
+        return;
+    uint word = 0;
+    uint x = first / components;
+    float4 colour = colourAt(uint2(x, id.y));
+    for (uint i = 0; i < 4 && first + i < rowBytes; ++i)
+    {
+        const uint byte = first + i;
+        if (byte / components != x)
+        {
+            x = byte / components;
+            colour = colourAt(uint2(x, id.y));
+        }
+        const float4 ordered = redFirst ? colour : colour.bgra;
+        word |= uint(round(saturate(ordered[byte % components]) * 255)) << (8 * i); // As UNORM conversion rounds, to nearest even
+    }
+    output.Store(offset + id.y * pitch + first, word);
+}
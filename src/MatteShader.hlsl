@@ -0,0 +1,95 @@
+// Refines a matte an effect produced at a fraction of the size of its input against that input, with a guided
+// filter guided by the input's luma. Run at the size of the matte, it writes the filter's coefficients a and b,
+// averaged over each pixel's window, which technique 3 of the output and pixel shaders samples at the size of the
+// target and applies to the luma of the input there: matte = a * luma + b. Edges in the matte then follow the
+// edges of the full size input, rather than being as soft as scaling the matte up leaves them. See
+// stubs/GuidedFilter.h for the filter and its CPU reference.
+//
+// Each group computes the filter over its tile and the margin of twice the radius around it that the averages need
+// in group shared memory, so the whole filter is one pass.
+
+cbuffer MatteFilter : register(b0)
+{
+    uint radius; // Of the window, at the size of the matte; at most MAX_RADIUS
+    float epsilon; // How much the guide needs to vary over a window for its edges to show in the matte
+};
+
+Texture2D input : register(t0);
+Texture2D matte : register(t1);
+RWTexture2D<float2> coefficients : register(u0);
+SamplerState ss : register(s0); // Left unbound for the default, linear and clamped
+
+#define GROUP_SIZE 8
+#define MAX_RADIUS 4
+#define MAX_TILE (GROUP_SIZE + 4 * MAX_RADIUS)
+
+// Guide, matte and 1 for each pixel of the tile and its margin, 0 outside the image; then a, b and 1 likewise, for
+// the tile and half the margin
+groupshared float3 pixels[MAX_TILE * MAX_TILE];
+groupshared float3 filters[MAX_TILE * MAX_TILE];
+
+float luma(float3 colour)
+{
+    return dot(colour, float3(0.2126, 0.7152, 0.0722));
+}
+
+[numthreads(GROUP_SIZE, GROUP_SIZE, 1)]
+void main(uint3 id : SV_DispatchThreadID, uint3 group : SV_GroupID, uint3 thread : SV_GroupThreadID, uint index : SV_GroupIndex)
+{
+    uint width, height, inputWidth, inputHeight;
+    coefficients.GetDimensions(width, height);
+    input.GetDimensions(inputWidth, inputHeight);
+    const uint r = min(radius, MAX_RADIUS);
+    const uint tile = GROUP_SIZE + 4 * r;
+    const uint inner = GROUP_SIZE + 2 * r;
+    const int2 origin = int2(group.xy * GROUP_SIZE) - int(2 * r);
+
+    // The input at the size of the matte, as the effect was given it
+    for (uint i = index; i < tile * tile; i += GROUP_SIZE * GROUP_SIZE)
+    {
+        const int2 pixel = origin + int2(i % tile, i / tile);
+        float3 value = 0;
+        if (all(pixel >= 0) && all(pixel < int2(width, height)))
+        {
+            const float4 colour = inputWidth == width && inputHeight == height ? input.Load(int3(pixel, 0)) : input.SampleLevel(ss, (float2(pixel) + 0.5) / float2(width, height), 0);
+            value = float3(luma(colour.rgb), matte.Load(int3(pixel, 0)).a, 1);
+        }
+        pixels[i] = value;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint j = index; j < inner * inner; j += GROUP_SIZE * GROUP_SIZE)
+    {
+        const uint2 centre = uint2(j % inner, j / inner) + r; // In the tile
+        float3 filter = 0;
+        if (pixels[centre.y * tile + centre.x].z > 0)
+        {
+            float4 sums = 0; // Of the guide I, matte p, I * I and I * p
+            float count = 0;
+            for (uint y = centre.y - r; y <= centre.y + r; ++y)
+            {
+                for (uint x = centre.x - r; x <= centre.x + r; ++x)
+                {
+                    const float3 value = pixels[y * tile + x];
+                    sums += float4(value.x, value.y, value.x * value.x, value.x * value.y);
+                    count += value.z;
+                }
+            }
+            const float4 means = sums / count;
+            const float a = (means.w - means.x * means.y) / (means.z - means.x * means.x + epsilon);
+            filter = float3(a, means.y - a * means.x, 1);
+        }
+        filters[j] = filter;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (id.x >= width || id.y >= height)
+        return;
+    float3 sums = 0;
+    for (uint y = thread.y; y <= thread.y + 2 * r; ++y)
+    {
+        for (uint x = thread.x; x <= thread.x + 2 * r; ++x)
+            sums += filters[y * inner + x];
+    }
+    coefficients[id.xy] = sums.xy / sums.z;
+}
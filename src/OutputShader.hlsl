@@ -0,0 +1,71 @@
+// The compute version of PixelShader.hlsl: composites, scales and converts an effect output into a stream target
+// in one pass, written through an unordered access view rather than drawn as a quad, so nothing but the shader,
+// its constants and the views needs binding. Technique 0 writes the output, 1 the input keyed by the output's
+// alpha, 2 the planar output and 3 the input keyed by the matte the output refines, see MatteShader.hlsl. Float
+// targets are written by OutputShaderFloat.hlsl, which only differs in the type of (target).
+
+cbuffer SceneConstantBuffer : register(b0)
+{
+    uint iTechnique;
+    uint iStraightAlpha;
+};
+
+Texture2D input : register(t0);
+Texture2D output : register(t1);
+#ifndef TARGET_TYPE
+#define TARGET_TYPE unorm float4
+#endif
+RWTexture2D<TARGET_TYPE> target : register(u0);
+SamplerState ss : register(s0); // Left unbound for the default, linear and clamped
+
+// Planar outputs hold the B, G and R planes one above the other in a single channel texture. Samples stay half a
+// texel inside their plane, so filtering doesn't blend in the edge of the plane next to it
+float4 samplePlanar(Texture2D planes, float2 uv)
+{
+    uint width, height;
+    planes.GetDimensions(width, height);
+    uv.y = clamp(uv.y / 3, 0.5 / height, 1.0 / 3 - 0.5 / height);
+    return float4(planes.SampleLevel(ss, uv + float2(0, 2.0 / 3), 0).r, planes.SampleLevel(ss, uv + float2(0, 1.0 / 3), 0).r, planes.SampleLevel(ss, uv, 0).r, 1);
+}
+
+// Refined mattes are the coefficients of a guided filter, applied to the luma of the input
+float refinedMatte(Texture2D filter, float2 uv, float3 colour)
+{
+    const float2 coefficients = filter.SampleLevel(ss, uv, 0).xy;
+    return saturate(coefficients.x * dot(colour, float3(0.2126, 0.7152, 0.0722)) + coefficients.y);
+}
+
+// The matte goes in the alpha channel, with the colour multiplied by it unless the alpha is straight
+float4 keyed(float4 colour, float matte)
+{
+    return float4(iStraightAlpha ? colour.rgb : colour.rgb * matte, colour.a * matte);
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID)
+{
+    uint width, height;
+    target.GetDimensions(width, height);
+    if (id.x >= width || id.y >= height)
+        return;
+
+    const float2 uv = (float2(id.xy) + 0.5) / float2(width, height);
+    switch (iTechnique)
+    {
+        case 1:
+            target[id.xy] = keyed(input.SampleLevel(ss, uv, 0), output.SampleLevel(ss, uv, 0).a);
+            break;
+        case 2:
+            target[id.xy] = samplePlanar(output, uv);
+            break;
+        case 3:
+        {
+            const float4 colour = input.SampleLevel(ss, uv, 0);
+            target[id.xy] = keyed(colour, refinedMatte(output, uv, colour.rgb));
+            break;
+        }
+        default:
+            target[id.xy] = output.SampleLevel(ss, uv, 0);
+            break;
+    }
+}
@@ -0,0 +1,5 @@
+// OutputShader.hlsl for float targets, which must be written through unordered access views of float rather than
+// unorm texels
+
+#define TARGET_TYPE float4
+#include "OutputShader.hlsl"
@@ -1,6 +1,7 @@
 cbuffer SceneConstantBuffer : register(b0)
 {
     uint iTechnique;
+    uint iStraightAlpha;
 };
 
 Texture2D input;
@@ -12,12 +13,42 @@ SamplerState ss
     AddressV = Wrap;
 };
 
+// Planar outputs hold the B, G and R planes one above the other in a single channel texture. Samples stay half a
+// texel inside their plane, so filtering doesn't blend in the edge of the plane next to it
+float4 samplePlanar(Texture2D planes, float2 uv)
+{
+    uint width, height;
+    planes.GetDimensions(width, height);
+    uv.y = clamp(uv.y / 3, 0.5 / height, 1.0 / 3 - 0.5 / height);
+    return float4(planes.Sample(ss, uv + float2(0, 2.0 / 3)).r, planes.Sample(ss, uv + float2(0, 1.0 / 3)).r, planes.Sample(ss, uv).r, 1);
+}
+
+// Refined mattes are the coefficients of a guided filter, applied to the luma of the input, see MatteShader.hlsl
+float refinedMatte(Texture2D filter, float2 uv, float3 colour)
+{
+    const float2 coefficients = filter.Sample(ss, uv).xy;
+    return saturate(coefficients.x * dot(colour, float3(0.2126, 0.7152, 0.0722)) + coefficients.y);
+}
+
+// The matte goes in the alpha channel, with the colour multiplied by it unless the alpha is straight
+float4 keyed(float4 colour, float matte)
+{
+    return float4(iStraightAlpha ? colour.rgb : colour.rgb * matte, colour.a * matte);
+}
+
 float4 main(float4 pos : SV_POSITION, float2 uv : TEXCOORD0) : SV_TARGET
 {
     switch (iTechnique)
     {
         case 1:
-            return input.Sample(ss, uv) * output.Sample(ss, uv).a;
+            return keyed(input.Sample(ss, uv), output.Sample(ss, uv).a);
+        case 2:
+            return samplePlanar(output, uv);
+        case 3:
+        {
+            const float4 colour = input.Sample(ss, uv);
+            return keyed(colour, refinedMatte(output, uv, colour.rgb));
+        }
         default:
             return output.Sample(ss, uv);
     }
@@ -6,6 +6,8 @@
 
 #include <iostream>
 #include <vector>
+#include <deque>
+#include <algorithm>
 #include <windows.h>
 #include <shlwapi.h>
 #include <tchar.h>
@@ -15,14 +17,26 @@
 #include <wrl.h>
 #include <unordered_map>
 #include <sstream>
+#include <future>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <optional>
 
 // auto-generated from hlsl
 #include "Generated_Code/VertexShader.h"
 #include "Generated_Code/PixelShader.h"
+#include "Generated_Code/InputShader.h"
+#include "Generated_Code/MatteShader.h"
+#include "Generated_Code/OutputShader.h"
+#include "Generated_Code/OutputShaderFloat.h"
 
 #include "../renderstream/d3renderstream.h"
 #include "../nvvfx/include/nvVideoEffects.h"
 #include "../nvvfx/include/nvTransferD3D11.h"
+#include "CudaProxy.h"
+#include "ResourceCache.h"
+#include "FrameProfiler.h"
 
 #if defined(UNICODE) || defined(_UNICODE)
 #define tcout std::wcout
@@ -186,23 +200,57 @@ static constexpr Vertex quadVertices[] =
 struct ConstantBufferStruct 
 {
     uint32_t iTechnique;
-    uint8_t padding[16-sizeof(iTechnique)];
+    uint32_t iStraightAlpha;
+    uint8_t padding[16-sizeof(iTechnique)-sizeof(iStraightAlpha)];
+};
+
+// The layout InputShader.hlsl writes an input in
+struct InputLayoutStruct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t pitch;
+    uint32_t offset;
+    uint32_t planar;
+    uint32_t components;
+    uint32_t redFirst;
+    uint8_t padding[32 - 7 * sizeof(uint32_t)];
+};
+
+// The guided filter MatteShader.hlsl refines mattes with
+struct MatteFilterStruct
+{
+    uint32_t radius;
+    float epsilon;
+    uint8_t padding[16 - sizeof(radius) - sizeof(epsilon)];
 };
 
 struct Texture
 {
     uint32_t width = 0;
     uint32_t height = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
     Microsoft::WRL::ComPtr<ID3D11Texture2D> resource;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
-    std::shared_ptr<NvCVImage> image;
+    Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav; // If created with (unorderedAccess)
+    std::shared_ptr<CUgraphicsResource_st> interop; // If shared with Cuda, for as long as the texture lives, see shareWithCuda
+    std::shared_ptr<NvCVImage> image; // Likewise, and has the texture's pixels only while it is mapped, see mapBatch
 };
 
-Texture createTexture(ID3D11Device* device, uint32_t width, uint32_t height, DXGI_FORMAT format)
+std::shared_ptr<CUgraphicsResource_st> registerWithCuda(ID3D11Resource* resource)
+{
+    CUgraphicsResource interop = nullptr;
+    if (cuGraphicsD3D11RegisterResource(&interop, resource, CU_GRAPHICS_REGISTER_FLAGS_NONE) != CUDA_SUCCESS)
+        return nullptr;
+    return std::shared_ptr<CUgraphicsResource_st>(interop, cuGraphicsUnregisterResource);
+}
+
+Texture createTexture(ID3D11Device* device, uint32_t width, uint32_t height, DXGI_FORMAT format, bool unorderedAccess = false)
 {
     Texture texture;
     texture.width = width;
     texture.height = height;
+    texture.format = format;
 
     D3D11_TEXTURE2D_DESC rtDesc;
     ZeroMemory(&rtDesc, sizeof(D3D11_TEXTURE2D_DESC));
@@ -213,7 +261,7 @@ Texture createTexture(ID3D11Device* device, uint32_t width, uint32_t height, DXG
     rtDesc.Format = format;
     rtDesc.SampleDesc.Count = 1;
     rtDesc.Usage = D3D11_USAGE_DEFAULT;
-    rtDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    rtDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | (unorderedAccess ? D3D11_BIND_UNORDERED_ACCESS : 0);
     rtDesc.CPUAccessFlags = 0;
     rtDesc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
     if (FAILED(device->CreateTexture2D(&rtDesc, nullptr, texture.resource.GetAddressOf())))
@@ -228,11 +276,336 @@ Texture createTexture(ID3D11Device* device, uint32_t width, uint32_t height, DXG
     if (FAILED(device->CreateShaderResourceView(texture.resource.Get(), &srvDesc, texture.srv.GetAddressOf())))
         throw std::runtime_error("Failed to create shader resource view for image parameter");
 
+    if (unorderedAccess)
+    {
+        D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+        ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+        uavDesc.Format = rtDesc.Format;
+        uavDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+        uavDesc.Texture2D.MipSlice = 0;
+        if (FAILED(device->CreateUnorderedAccessView(texture.resource.Get(), &uavDesc, texture.uav.GetAddressOf())))
+            throw std::runtime_error("Failed to create unordered access view for image parameter");
+    }
+
+    return texture;
+}
+
+// Registers (texture) with Cuda and gives it an image to transfer to and from while it is mapped
+void shareWithCuda(Texture& texture)
+{
+    texture.interop = registerWithCuda(texture.resource.Get());
+    if (!texture.interop)
+        throw std::runtime_error("Failed to register texture for image parameter with Cuda");
+
+    NvCVImage_PixelFormat pixelFormat;
+    NvCVImage_ComponentType componentType;
+    unsigned char layout;
     texture.image = std::make_shared<NvCVImage>();
-    if (NvCVImage_InitFromD3D11Texture(texture.image.get(), texture.resource.Get()) != NVCV_SUCCESS)
+    if (NvCVImage_FromD3DFormat(texture.format, &pixelFormat, &componentType, &layout) != NVCV_SUCCESS
+        || NvCVImage_Init(texture.image.get(), texture.width, texture.height, 0, nullptr, pixelFormat, componentType, layout, NVCV_CUDA_ARRAY) != NVCV_SUCCESS)
         throw std::runtime_error("Failed to create Nvidia CV image for image parameter");
+}
 
-    return texture;
+// A raw D3D11 buffer shared with Cuda, which maps it as linear memory rather than as an array as it does textures,
+// so an image in any layout an effect takes can be laid over it and given to the effect as it is
+struct InteropBuffer
+{
+    uint64_t bytes = 0;
+    Microsoft::WRL::ComPtr<ID3D11Buffer> resource;
+    Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav; // Raw, written a 32 bit word at a time
+    std::shared_ptr<CUgraphicsResource_st> interop;
+};
+
+InteropBuffer createInteropBuffer(ID3D11Device* device, uint64_t bytes)
+{
+    InteropBuffer buffer;
+    buffer.bytes = (bytes + 3) / 4 * 4;
+    if (buffer.bytes > std::numeric_limits<UINT>::max())
+        throw std::runtime_error("Effect input is too large for a buffer");
+
+    CD3D11_BUFFER_DESC bufferDesc(UINT(buffer.bytes), D3D11_BIND_UNORDERED_ACCESS, D3D11_USAGE_DEFAULT, 0, D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS);
+    if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, buffer.resource.GetAddressOf())))
+        throw std::runtime_error("Failed to create buffer for effect input");
+
+    D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+    ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+    uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+    uavDesc.Buffer.FirstElement = 0;
+    uavDesc.Buffer.NumElements = UINT(buffer.bytes / 4);
+    uavDesc.Buffer.Flags = D3D11_BUFFER_UAV_FLAG_RAW;
+    if (FAILED(device->CreateUnorderedAccessView(buffer.resource.Get(), &uavDesc, buffer.uav.GetAddressOf())))
+        throw std::runtime_error("Failed to create unordered access view for effect input");
+
+    buffer.interop = registerWithCuda(buffer.resource.Get());
+    if (!buffer.interop)
+        throw std::runtime_error("Failed to register buffer for effect input with Cuda");
+    return buffer;
+}
+
+// Whether InputShader.hlsl can write an effect input of (format), (type) and (layout): planar F32 BGR, or 8 bit
+// chunky with three or four components
+bool inputShaderWrites(NvCVImage_PixelFormat format, NvCVImage_ComponentType type, unsigned char layout)
+{
+    if (layout == NVCV_PLANAR)
+        return format == NVCV_BGR && type == NVCV_F32;
+    return type == NVCV_U8 && (format == NVCV_BGR || format == NVCV_RGB || format == NVCV_BGRA || format == NVCV_RGBA);
+}
+
+// Resources shared with Cuda that are mapped together, so a frame makes one map and one unmap call for all of its
+// inputs, and likewise its outputs, however many there are. D3D can't use a resource while it is mapped, and it
+// writes the inputs and reads the outputs every frame, so they are mapped only for as long as Cuda uses them.
+struct InteropBatch
+{
+    std::vector<CUgraphicsResource> resources;
+    std::vector<NvCVImage*> images; // Over the resources in (resources), owned by whatever owns the resources
+};
+
+void addToBatch(InteropBatch& batch, const Texture& texture)
+{
+    batch.resources.push_back(texture.interop.get());
+    batch.images.push_back(texture.image.get());
+}
+
+void addToBatch(InteropBatch& batch, const InteropBuffer& buffer, NvCVImage* image)
+{
+    batch.resources.push_back(buffer.interop.get());
+    batch.images.push_back(image);
+}
+
+// Maps the batch for work queued on (stream) after this, and points each image at its resource's pixels: the
+// array of a texture, or the memory of a buffer. Returns false if it could not be, in which case nothing is left
+// mapped.
+bool mapBatch(InteropBatch& batch, CUstream stream)
+{
+    if (cuGraphicsMapResources(unsigned(batch.resources.size()), batch.resources.data(), stream) != CUDA_SUCCESS)
+        return false;
+    for (size_t i = 0; i < batch.resources.size(); ++i)
+    {
+        NvCVImage* image = batch.images[i];
+        bool mapped;
+        if (image->gpuMem == NVCV_CUDA_ARRAY)
+        {
+            CUarray array;
+            mapped = cuGraphicsSubResourceGetMappedArray(&array, batch.resources[i], 0, 0) == CUDA_SUCCESS;
+            image->pixels = mapped ? array : nullptr;
+        }
+        else
+        {
+            CUdeviceptr pointer;
+            size_t bytes;
+            mapped = cuGraphicsResourceGetMappedPointer(&pointer, &bytes, batch.resources[i]) == CUDA_SUCCESS;
+            image->pixels = mapped ? reinterpret_cast<void*>(pointer) : nullptr;
+        }
+        if (!mapped)
+        {
+            for (NvCVImage* image : batch.images)
+                image->pixels = nullptr;
+            cuGraphicsUnmapResources(unsigned(batch.resources.size()), batch.resources.data(), stream);
+            return false;
+        }
+    }
+    return true;
+}
+
+// D3D waits for the work queued on (stream) so far before it next uses the textures
+bool unmapBatch(InteropBatch& batch, CUstream stream)
+{
+    for (NvCVImage* image : batch.images)
+        image->pixels = nullptr;
+    return cuGraphicsUnmapResources(unsigned(batch.resources.size()), batch.resources.data(), stream) == CUDA_SUCCESS;
+}
+
+// Owns a Cuda event recorded after a frame's work so the host can tell when it has completed
+struct CompletionEvent
+{
+    explicit CompletionEvent(unsigned int flags = CU_EVENT_DISABLE_TIMING)
+    {
+        if (cuEventCreate(&event, flags) != CUDA_SUCCESS)
+            throw std::runtime_error("Failed to create Cuda event");
+    }
+    ~CompletionEvent()
+    {
+        if (event)
+            cuEventDestroy(event);
+    }
+
+    CompletionEvent(const CompletionEvent&) = delete;
+    CompletionEvent(CompletionEvent&& other) noexcept
+        : event(other.event)
+    {
+        other.event = nullptr;
+    }
+    CompletionEvent& operator=(const CompletionEvent&) = delete;
+    CompletionEvent& operator=(CompletionEvent&& other) noexcept
+    {
+        std::swap(event, other.event);
+        return *this;
+    }
+
+    CUevent event = nullptr;
+};
+
+// Everything needed to run one frame of a scene at a given input size
+struct EffectResources
+{
+    uint32_t effectWidth = 0; // Size of each image the effect takes, which may be less than the input size
+    uint32_t effectHeight = 0;
+    float scale = 1.f; // Of the effect output over the effect size, for effects that scale up
+    std::vector<Texture> inputs; // One per image parameter
+    InteropBuffer inputBuffer; // Every input, converted to the effect size and layout by inputShader
+    std::shared_ptr<NvCVImage> effectInput; // Every input, batched; laid over inputBuffer while it is mapped
+    std::vector<Texture> outputs; // One per image parameter, planar if the effect output is
+    std::shared_ptr<NvCVImage> effectOutput; // Every output, batched; of the last effect, for scenes that chain effects
+    // For scenes that chain effects, one per chained effect: the output of the effect before it, and its input, which
+    // is the same image unless the two effects' layouts differ. Every output, batched, at the effect size.
+    std::vector<std::shared_ptr<NvCVImage>> chainOutputs;
+    std::vector<std::shared_ptr<NvCVImage>> chainInputs;
+    std::vector<Texture> matteFilters; // One per output, for effects whose mattes are refined against their inputs, see MatteShader.hlsl
+    InteropBatch inputBatch; // inputBuffer, as effectInput
+    InteropBatch outputBatch; // The outputs
+    CompletionEvent produced; // Recorded after the last run of the effect on these, for effects that take its output as a matte
+};
+
+struct EffectResourcesKey
+{
+    uint32_t scene;
+    uint32_t width;
+    uint32_t height;
+    DXGI_FORMAT format;
+    uint32_t effectWidth;
+    uint32_t effectHeight;
+    float scale;
+
+    bool operator==(const EffectResourcesKey& other) const
+    {
+        return scene == other.scene && width == other.width && height == other.height && format == other.format
+            && effectWidth == other.effectWidth && effectHeight == other.effectHeight && scale == other.scale;
+    }
+};
+
+struct EffectResourcesKeyHash
+{
+    size_t operator()(const EffectResourcesKey& key) const
+    {
+        size_t hash = std::hash<uint32_t>()(key.scene);
+        hash = hash * 31 + std::hash<uint32_t>()(key.width);
+        hash = hash * 31 + std::hash<uint32_t>()(key.height);
+        hash = hash * 31 + std::hash<uint32_t>()(key.format);
+        hash = hash * 31 + std::hash<uint32_t>()(key.effectWidth);
+        hash = hash * 31 + std::hash<uint32_t>()(key.effectHeight);
+        hash = hash * 31 + std::hash<float>()(key.scale);
+        return hash;
+    }
+};
+
+using EffectResourcesCache = ResourceCache<EffectResourcesKey, EffectResources, EffectResourcesKeyHash>;
+
+// Of the formats textures are created in
+uint32_t texelBytes(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R32G32B32A32_FLOAT: return 16;
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R32G32_FLOAT: return 8;
+    case DXGI_FORMAT_A8_UNORM: return 1;
+    default: return 4;
+    }
+}
+
+uint64_t textureBytes(const Texture& texture)
+{
+    return uint64_t(texture.width) * texture.height * texelBytes(texture.format);
+}
+
+uint64_t imageBytes(const std::shared_ptr<NvCVImage>& image)
+{
+    return image ? image->bufferBytes : 0;
+}
+
+// Batched images hold the images of the batch one after the other; for planar images that is every plane of the
+// first image, then every plane of the second and so on. Initialises (view) as the (n)th image of (batch).
+void nthImage(NvCVImage* batch, unsigned n, unsigned height, NvCVImage* view)
+{
+    if (batch->planar == NVCV_PLANAR)
+    {
+        char* pixels = static_cast<char*>(batch->pixels) + ptrdiff_t(n) * height * batch->numComponents * batch->pitch;
+        NvCVImage_Init(view, batch->width, height, batch->pitch, pixels, batch->pixelFormat, batch->componentType, NVCV_PLANAR, batch->gpuMem);
+    }
+    else
+    {
+        NvCVImage_InitView(view, batch, 0, int(n * height), batch->width, height);
+    }
+}
+
+// Planar images hold each plane one above the other, the same as a single channel image as many times as tall.
+// Initialises (view) as that single channel image of (planar), in (pixelFormat), so planar images can be copied to
+// and from planar textures without any conversion.
+void planesAsImage(NvCVImage* planar, NvCVImage_PixelFormat pixelFormat, NvCVImage* view)
+{
+    NvCVImage_Init(view, planar->width, planar->height * planar->numComponents, planar->pitch, planar->pixels, pixelFormat, planar->componentType, NVCV_CHUNKY, planar->gpuMem);
+}
+
+// The scale NvCVImage_Transfer takes to convert (from) to (to): floating point components go from 0 to 1, integer
+// components over their whole range
+float transferScale(const NvCVImage& from, const NvCVImage& to)
+{
+    const auto isFloat = [](NvCVImage_ComponentType type) { return type == NVCV_F16 || type == NVCV_F32; };
+    const auto range = [](NvCVImage_ComponentType type) { return type == NVCV_U8 ? 255.f : type == NVCV_U16 ? 65535.f : 1.f; };
+    if (isFloat(from.componentType) == isFloat(to.componentType))
+        return 1.f;
+    return isFloat(from.componentType) ? range(to.componentType) : 1.f / range(from.componentType);
+}
+
+// The smallest size, in the aspect ratio of a (width) x (height) input, that covers (targetWidth) x (targetHeight)
+// once scaled up by (factor). Never more than the input size.
+std::pair<uint32_t, uint32_t> fitInputSize(uint32_t width, uint32_t height, float factor, uint32_t targetWidth, uint32_t targetHeight)
+{
+    const double scale = std::min(1., std::max(double(targetWidth) / (double(width) * factor), double(targetHeight) / (double(height) * factor)));
+    return { std::max(1u, uint32_t(std::ceil(width * scale))), std::max(1u, uint32_t(std::ceil(height * scale))) };
+}
+
+// The texture format d3 exchanges images in (format) as, both the frames sent to streams and image parameters
+DXGI_FORMAT rsTextureFormat(RSPixelFormat format)
+{
+    switch (format)
+    {
+    case RS_FMT_BGRX8:
+        return DXGI_FORMAT_B8G8R8X8_UNORM;
+    case RS_FMT_RGBA32F:
+        return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    case RS_FMT_RGBA16:
+        return DXGI_FORMAT_R16G16B16A16_UNORM;
+    default:
+        return DXGI_FORMAT_B8G8R8A8_UNORM;
+    }
+}
+
+// The scale factor, of the ascending (factors), that takes a (width) x (height) input closest to covering
+// (targetWidth) x (targetHeight): the smallest that covers it, or the largest if none does. Whatever is left over
+// is resampled as the output is drawn.
+float chooseScale(const std::vector<float>& factors, uint32_t width, uint32_t height, uint32_t targetWidth, uint32_t targetHeight)
+{
+    const double needed = std::max(double(targetWidth) / width, double(targetHeight) / height);
+    for (float factor : factors)
+    {
+        if (factor >= needed - 1e-3) // Within rounding, 4/3 of 1440 is 1920
+            return factor;
+    }
+    return factors.back();
+}
+
+// Size of the output of an effect scaling a (size) input by (scale)
+uint32_t scaledSize(uint32_t size, float scale)
+{
+    return std::max(1u, uint32_t(std::lround(size * scale)));
+}
+
+// Size an effect that runs at 1 / (divisor) of (size) runs at
+uint32_t dividedSize(uint32_t size, uint32_t divisor)
+{
+    return std::max(1u, (size + divisor - 1) / divisor);
 }
 
 enum class NVVFXMode : uint32_t
@@ -241,6 +614,39 @@ enum class NVVFXMode : uint32_t
     Performance = 1
 };
 
+// An effect setting exposed to d3 as a numeric remote parameter of the effect's scene. The model is loaded for
+// the value it is set to, so changing it means loading the model again.
+struct EffectSetting
+{
+    NvVFX_ParameterSelector selector;
+    const char* key;
+    const char* displayName;
+    std::vector<const char*> options; // Shown as a drop down if set, the value is the index of the option chosen
+    uint32_t min;
+    uint32_t max;
+    uint32_t defaultValue;
+    uint32_t chainIndex = 0; // Which effect of the scene's chain it is set on, 0 for the scene's own effect
+};
+
+// An effect a scene runs after its own, on the output of the effect before it, which it takes straight from GPU
+// memory: as it is if it takes the same layout, or converted to this one's input layout if not
+struct ChainedEffect
+{
+    NvVFX_EffectSelector selector;
+    NvCVImage_PixelFormat inputPixelFormat;
+    NvCVImage_ComponentType inputComponentType;
+    unsigned char inputLayout;
+    NvCVImage_PixelFormat outputPixelFormat;
+    NvCVImage_ComponentType outputComponentType;
+    unsigned char outputLayout;
+    std::vector<std::pair<NvVFX_ParameterSelector, uint32_t>> settings; // Set on every instance
+};
+
+uint32_t settingValue(const EffectSetting& setting, float value)
+{
+    return uint32_t(std::lround(std::clamp(value, float(setting.min), float(setting.max))));
+}
+
 NvVFX_Handle createEffect(NvVFX_EffectSelector effectName, CUstream stream)
 {
     const std::string displayName = std::string(effectName);
@@ -265,6 +671,15 @@ NvVFX_Handle createEffect(NvVFX_EffectSelector effectName, CUstream stream)
     return effect;
 }
 
+// Runs (batchSize) images through the effect with each NvVFX_Run
+void setBatchSize(NvVFX_Handle effect, const std::string& name, uint32_t batchSize)
+{
+    if (NvVFX_SetU32(effect, NVVFX_BATCH_SIZE, batchSize) != NVCV_SUCCESS)
+        throw std::runtime_error("Failed to set batch size on " + name + " effect");
+    // The preferred model is only a hint, the SDK falls back to the models it has
+    NvVFX_SetU32(effect, NVVFX_MODEL_BATCH, batchSize);
+}
+
 decltype(rs_logToD3)* g_rs_logToD3 = nullptr;
 
 void logToD3(const char* message)
@@ -273,8 +688,102 @@ void logToD3(const char* message)
         g_rs_logToD3(message);
 }
 
+// Frames in flight: one being fetched, one running through its effect and one being sent
+static constexpr size_t MAX_FRAMES_IN_FLIGHT = 3;
+// How long to wait for another frame request before sending the frames in flight
+static constexpr int PIPELINE_POLL_MS = 1;
+
+// How long to wait before retrying an effect that failed to load
+static constexpr std::chrono::seconds RELOAD_RETRY_INTERVAL(5);
+
+// The guided filter that refines the mattes of effects run at a fraction of the input size, see MatteShader.hlsl:
+// the radius of its window at the size of the matte, and how much the input must vary over it for an edge to show
+static constexpr uint32_t MATTE_FILTER_RADIUS = 2;
+static constexpr float MATTE_FILTER_EPSILON = 1e-3f;
+
+// Stages of a frame timed by the profiler
+enum class FrameStage : size_t
+{
+    Await, // For d3 to request a frame
+    Fetch, // Image parameters from d3
+    TransferIn, // Image parameters to the effect input
+    Inference, // On the GPU
+    Wait, // For the effect output, once it is needed
+    TransferOut, // Effect output to the output textures
+    Refine, // Mattes against the inputs
+    Draw,
+    Send,
+    Count
+};
+
+struct Options
+{
+    uint64_t cacheBudgetBytes = 2048ull << 20; // GPU memory to keep effect resources for scenes and sizes not in use
+    uint32_t warmupWidth = 1920; // Output size to load effects for if no streams are known at startup
+    uint32_t warmupHeight = 1080;
+    uint32_t batchSize = 1; // Image parameters for scenes whose effect supports batching
+    uint32_t instances = 1; // Instances of each effect, each on its own Cuda stream
+    uint32_t profileWindow = 300; // Frames the profiling percentiles sent to d3 cover
+    bool fitToStreams = true; // Run effects at the smallest size that serves the streams a frame is sent to
+    bool computeOutput = true; // Write stream targets with a compute shader rather than drawing them, if the device can
+    uint32_t matteDivisor = 1; // Green screen runs at 1/this of the size it otherwise would, its matte refined against the input
+    bool premultiplyMatte = true; // Green screen colour is multiplied by the matte it sends in the alpha channel
+};
+
+// Options are passed as --name=value, anything not recognised is ignored
+Options parseOptions(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const size_t equals = arg.find('=');
+        const std::string name = arg.substr(0, equals);
+        const std::string value = equals == std::string::npos ? std::string() : arg.substr(equals + 1);
+        try
+        {
+            if (name == "--cache-budget-mb")
+                options.cacheBudgetBytes = std::stoull(value) << 20;
+            else if (name == "--batch-size")
+                options.batchSize = std::max(1ul, std::stoul(value));
+            else if (name == "--instances")
+                options.instances = std::max(1ul, std::stoul(value));
+            else if (name == "--profile-window")
+                options.profileWindow = std::max(1ul, std::stoul(value));
+            else if (name == "--fit-to-streams")
+                options.fitToStreams = std::stoul(value) != 0;
+            else if (name == "--compute-output")
+                options.computeOutput = std::stoul(value) != 0;
+            else if (name == "--premultiply-matte")
+                options.premultiplyMatte = std::stoul(value) != 0;
+            else if (name == "--matte-divisor")
+            {
+                const unsigned long divisor = std::stoul(value);
+                if (divisor != 1 && divisor != 2 && divisor != 4)
+                    throw std::invalid_argument(value);
+                options.matteDivisor = uint32_t(divisor);
+            }
+            else if (name == "--warmup-size")
+            {
+                const size_t x = value.find('x');
+                options.warmupWidth = std::stoul(value.substr(0, x));
+                options.warmupHeight = std::stoul(value.substr(x == std::string::npos ? x : x + 1));
+            }
+            else
+                tcerr << "Ignoring unknown option: " << arg.c_str() << std::endl;
+        }
+        catch (const std::exception&)
+        {
+            tcerr << "Ignoring invalid value for option: " << arg.c_str() << std::endl;
+        }
+    }
+    return options;
+}
+
 int main(int argc, char** argv)
 {
+    const Options options = parseOptions(argc, argv);
+
     HMODULE hLib = loadRenderStream();
     if (!hLib)
     {
@@ -306,6 +815,7 @@ int main(int argc, char** argv)
     LOAD_FN(rs_shutdown);
     LOAD_FN(rs_logToD3);
     LOAD_FN(rs_setNewStatusMessage);
+    LOAD_FN(rs_sendProfilingData);
 
     g_rs_logToD3 = rs_logToD3;
     rs_registerLoggingFunc(logToD3);
@@ -379,6 +889,43 @@ return 41;
             return 45;
         }
     }
+    Microsoft::WRL::ComPtr<ID3D11ComputeShader> inputShader;
+    {
+        if (FAILED(device->CreateComputeShader(InputShaderBlob, std::size(InputShaderBlob), nullptr, inputShader.GetAddressOf())))
+        {
+            tcerr << "Failed to initialise DirectX 11: input shader" << std::endl;
+            rs_shutdown();
+            return 47;
+        }
+    }
+    Microsoft::WRL::ComPtr<ID3D11ComputeShader> matteShader;
+    {
+        if (FAILED(device->CreateComputeShader(MatteShaderBlob, std::size(MatteShaderBlob), nullptr, matteShader.GetAddressOf())))
+        {
+            tcerr << "Failed to initialise DirectX 11: matte shader" << std::endl;
+            rs_shutdown();
+            return 49;
+        }
+    }
+    Microsoft::WRL::ComPtr<ID3D11ComputeShader> outputShader;
+    {
+        if (FAILED(device->CreateComputeShader(OutputShaderBlob, std::size(OutputShaderBlob), nullptr, outputShader.GetAddressOf())))
+        {
+            tcerr << "Failed to initialise DirectX 11: output shader" << std::endl;
+            rs_shutdown();
+            return 48;
+        }
+    }
+    // The same for float targets, whose unordered access views are declared as float rather than unorm
+    Microsoft::WRL::ComPtr<ID3D11ComputeShader> outputFloatShader;
+    {
+        if (FAILED(device->CreateComputeShader(OutputShaderFloatBlob, std::size(OutputShaderFloatBlob), nullptr, outputFloatShader.GetAddressOf())))
+        {
+            tcerr << "Failed to initialise DirectX 11: output shader" << std::endl;
+            rs_shutdown();
+            return 48;
+        }
+    }
     Microsoft::WRL::ComPtr<ID3D11Buffer> constantBuffer;
     {
         CD3D11_BUFFER_DESC constantBufferDesc(sizeof(ConstantBufferStruct), D3D11_BIND_CONSTANT_BUFFER);
@@ -389,6 +936,33 @@ return 41;
             return 46;
         }
     }
+    Microsoft::WRL::ComPtr<ID3D11Buffer> inputLayoutBuffer;
+    {
+        CD3D11_BUFFER_DESC constantBufferDesc(sizeof(InputLayoutStruct), D3D11_BIND_CONSTANT_BUFFER);
+        if (FAILED(device->CreateBuffer(&constantBufferDesc, nullptr, inputLayoutBuffer.GetAddressOf())))
+        {
+            tcerr << "Failed to initialise DirectX 11: input layout constant buffer" << std::endl;
+            rs_shutdown();
+            return 46;
+        }
+    }
+    // The filter is the same for every matte, so its constants never change
+    Microsoft::WRL::ComPtr<ID3D11Buffer> matteFilterBuffer;
+    {
+        MatteFilterStruct matteFilter = {};
+        matteFilter.radius = MATTE_FILTER_RADIUS;
+        matteFilter.epsilon = MATTE_FILTER_EPSILON;
+        CD3D11_BUFFER_DESC constantBufferDesc(sizeof(MatteFilterStruct), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_IMMUTABLE);
+        D3D11_SUBRESOURCE_DATA constantData;
+        ZeroMemory(&constantData, sizeof(D3D11_SUBRESOURCE_DATA));
+        constantData.pSysMem = &matteFilter;
+        if (FAILED(device->CreateBuffer(&constantBufferDesc, &constantData, matteFilterBuffer.GetAddressOf())))
+        {
+            tcerr << "Failed to initialise DirectX 11: matte filter constant buffer" << std::endl;
+            rs_shutdown();
+            return 46;
+        }
+    }
 
     if (rs_initialiseGpGpuWithDX11Device(device.Get()) != RS_ERROR_SUCCESS)
     {
@@ -397,16 +971,59 @@ return 41;
         return 5;
     }
 
-    CUstream cuStream;
-    if (NvVFX_CudaStreamCreate(&cuStream) != NVCV_SUCCESS)
+    // An effect can run on several instances at once, each with its own Cuda stream, so frames for different
+    // scenes (or back to back frames for the same one) don't have to wait for each other on the GPU
+    struct EffectInstance
     {
-        tcerr << "Failed to create Nvidia Maxine VFX Cuda stream" << std::endl;
-        rs_shutdown();
-        return 51;
-    }
+        NvVFX_Handle effect = nullptr;
+        std::vector<NvVFX_Handle> chain; // One per effect the scene chains after (effect), on the same stream
+        // For effects that take a matte, an instance of the matte scene's effect of their own, on the same stream, so
+        // it is loaded, replaced and warmed up with (effect) at the size (effect) runs at, and never takes an
+        // instance of the matte scene away from that scene's own frames
+        NvVFX_Handle matte = nullptr;
+        CUstream stream = nullptr;
+        std::shared_ptr<NvCVImage> temporary = std::make_shared<NvCVImage>(); // Scratch space for transfers on (stream)
+        uint64_t lastUsed = 0; // Frame number this instance was last scheduled for
+
+        enum class State { Unloaded, Loading, Ready, Failed };
+        State state = State::Unloaded;
+        std::future<NvCV_Status> loading; // Background NvVFX_Load, while Loading
+        std::shared_ptr<EffectResources> loadingResources; // Images set on the effect for the load, while Loading
+        std::shared_ptr<EffectResources> loadingMatte; // Likewise, of (matte)
+        std::chrono::steady_clock::time_point failedAt;
+
+        std::vector<uint32_t> settings; // Values of the effect's live settings the instance was last loaded with
+        std::vector<uint32_t> matteSettings; // Likewise, of the matte scene's effect, for (matte)
+        // The size of the images the instance was last loaded for and the factor it scales them up by, which the model
+        // is loaded for as much as for the settings, so are the only ones it can run at
+        uint32_t loadedWidth = 0;
+        uint32_t loadedHeight = 0;
+        float loadedScale = 1.f;
+        // Loaded with newer settings in the background while this instance keeps running frames, and swapped in
+        // for it once loaded and warmed up on its own images (warmupResources)
+        std::unique_ptr<EffectInstance> replacement;
+        std::shared_ptr<EffectResources> warmupResources;
+        std::shared_ptr<EffectResources> warmupMatte; // For (matte) to segment warmupResources into
+        std::optional<CompletionEvent> warmedUp; // Created once the stream is, so Cuda has been initialised
+
+        ~EffectInstance()
+        {
+            if (loading.valid())
+                loading.wait();
+            if (effect)
+                NvVFX_DestroyEffect(effect);
+            for (NvVFX_Handle chained : chain)
+                NvVFX_DestroyEffect(chained);
+            if (matte)
+                NvVFX_DestroyEffect(matte);
+            if (stream)
+                NvVFX_CudaStreamDestroy(stream);
+        }
+    };
     struct Effect
     {
         std::string name;
+        NvVFX_EffectSelector selector;
         NvCVImage_PixelFormat inputPixelFormat;
         NvCVImage_ComponentType inputComponentType;
         unsigned char inputLayout;
@@ -414,16 +1031,103 @@ return 41;
         NvCVImage_PixelFormat outputPixelFormat;
         NvCVImage_ComponentType outputComponentType;
         unsigned char outputLayout;
-        NvVFX_Handle effect;
-        bool upscale;
-        int shaderTechnique;
-        bool loaded = false;
+        std::vector<float> scales; // Factors the effect (or the last of its chain) can scale up by, ascending; 1 for effects that keep the size
+        int shaderTechnique; // 1 for mattes, 2 if the output textures are planar, 3 for mattes refined against the input
+        std::vector<std::pair<NvVFX_ParameterSelector, uint32_t>> settings; // Set on every instance
+        std::vector<EffectSetting> liveSettings; // Remote parameters of the scene, after its image parameters
+        uint32_t batchSize = 1; // Number of image parameters, all run through the effect at once
+        uint32_t inputDivisor = 1; // Runs at 1/this of the size it otherwise would, for mattes refined against the input
+        // Scene whose effect's output this effect takes as NVVFX_INPUT_IMAGE_1, at the size of its input; that effect
+        // is run on this one's input, so must take it in the same layout, for a batch of one. -1 if it takes none.
+        int matteScene = -1;
+        // Effects run after this one, each on the output of the one before, the last producing the scene's output
+        // (and the output texture format and shader technique above are of that). Only the last can scale up.
+        std::vector<ChainedEffect> chain;
+
+        std::vector<std::unique_ptr<EffectInstance>> instances;
+        std::vector<uint32_t> settingValues; // Current values of (liveSettings), as last set in d3
+        std::vector<float> parameterData; // For rs_getFrameParameters
+
+        // The resources of the last frame run through the effect and what it was run with, so frames that would
+        // produce the same output can be drawn from it instead
+        std::shared_ptr<EffectResources> lastOutput;
+        std::vector<int64_t> lastImageIds;
+        std::vector<uint32_t> lastSettings;
+        std::vector<uint32_t> lastMatteSettings; // Those of the matte scene's effect, for effects that take a matte
+    };
+    // A live setting the effect rejects is logged and left as it was, the rest of the effect still works without it
+    auto applySettings = [&](const Effect& effect, EffectInstance& instance)
+    {
+        for (size_t i = 0; i < effect.liveSettings.size(); ++i)
+        {
+            const EffectSetting& setting = effect.liveSettings[i];
+            if (NvVFX_SetU32(setting.chainIndex ? instance.chain[setting.chainIndex - 1] : instance.effect, setting.selector, effect.settingValues[i]) != NVCV_SUCCESS)
+                rs_logToD3(("Failed to set " + std::string(effect.liveSettings[i].selector) + " on " + effect.name + " effect\n").c_str());
+        }
+        instance.settings = effect.settingValues;
+    };
+    // Likewise for the instance's own matte effect, with the live settings of (matteEffect), the matte scene's
+    auto applyMatteSettings = [&](const Effect& matteEffect, EffectInstance& instance)
+    {
+        for (size_t i = 0; i < matteEffect.liveSettings.size(); ++i)
+        {
+            const EffectSetting& setting = matteEffect.liveSettings[i];
+            if (NvVFX_SetU32(instance.matte, setting.selector, matteEffect.settingValues[i]) != NVCV_SUCCESS)
+                rs_logToD3(("Failed to set " + std::string(setting.selector) + " on " + matteEffect.name + " effect\n").c_str());
+        }
+        instance.matteSettings = matteEffect.settingValues;
+    };
+    // (matteEffect) is the effect of the matte scene, for effects that take a matte
+    auto createInstance = [&](const Effect& effect, const Effect* matteEffect) -> std::unique_ptr<EffectInstance>
+    {
+        auto instance = std::make_unique<EffectInstance>();
+        if (NvVFX_CudaStreamCreate(&instance->stream) != NVCV_SUCCESS)
+            throw std::runtime_error("Failed to create Cuda stream for " + effect.name + " effect");
+        instance->warmedUp.emplace();
+        instance->effect = createEffect(effect.selector, instance->stream);
+        for (const auto& [parameter, value] : effect.settings)
+        {
+            if (NvVFX_SetU32(instance->effect, parameter, value) != NVCV_SUCCESS)
+                throw std::runtime_error("Failed to set " + std::string(parameter) + " on " + effect.name + " effect");
+        }
+        if (effect.batchSize > 1)
+            setBatchSize(instance->effect, effect.name, effect.batchSize);
+        for (const ChainedEffect& chained : effect.chain)
+        {
+            const std::string name = effect.name + " (" + chained.selector + ")";
+            instance->chain.push_back(createEffect(chained.selector, instance->stream));
+            for (const auto& [parameter, value] : chained.settings)
+            {
+                if (NvVFX_SetU32(instance->chain.back(), parameter, value) != NVCV_SUCCESS)
+                    throw std::runtime_error("Failed to set " + std::string(parameter) + " on " + name + " effect");
+            }
+            if (effect.batchSize > 1)
+                setBatchSize(instance->chain.back(), name, effect.batchSize);
+        }
+        applySettings(effect, *instance);
+        if (matteEffect)
+        {
+            instance->matte = createEffect(matteEffect->selector, instance->stream);
+            for (const auto& [parameter, value] : matteEffect->settings)
+            {
+                if (NvVFX_SetU32(instance->matte, parameter, value) != NVCV_SUCCESS)
+                    throw std::runtime_error("Failed to set " + std::string(parameter) + " on " + matteEffect->name + " effect");
+            }
+            applyMatteSettings(*matteEffect, *instance);
+        }
+        return instance;
     };
     std::vector<Effect> effects;
+    // The effect of the scene (effect) takes its matte from, null if it takes none
+    const auto matteEffectOf = [&](const Effect& effect) -> Effect*
+    {
+        return effect.matteScene >= 0 ? &effects[effect.matteScene] : nullptr;
+    };
     try
     {
         effects.push_back({
             /*.name = */ "Transfer",
+            /*.selector = */ NVVFX_FX_TRANSFER,
             /*.inputPixelFormat = */ NVCV_BGR,
             /*.inputComponentType = */ NVCV_U8,
             /*.inputLayout = */ NVCV_CHUNKY,
@@ -431,12 +1135,15 @@ return 41;
             /*.outputPixelFormat = */ NVCV_BGR,
             /*.outputComponentType = */ NVCV_U8,
             /*.outputLayout = */ NVCV_CHUNKY,
-            /*.effect = */ createEffect(NVVFX_FX_TRANSFER, cuStream),
-            /*.upscale = */ false,
+            /*.scales = */ { 1.f },
             /*.shaderTechnique = */ 0,
+            /*.settings = */ {},
+            /*.liveSettings = */ {},
         });
+        const int greenScreenScene = int(effects.size());
         effects.push_back({
             /*.name = */ "Green screen",
+            /*.selector = */ NVVFX_FX_GREEN_SCREEN,
             /*.inputPixelFormat = */ NVCV_BGR,
             /*.inputComponentType = */ NVCV_U8,
             /*.inputLayout = */ NVCV_CHUNKY,
@@ -444,46 +1151,55 @@ return 41;
             /*.outputPixelFormat = */ NVCV_A,
             /*.outputComponentType = */ NVCV_U8,
             /*.outputLayout = */ NVCV_CHUNKY,
-            /*.effect = */ createEffect(NVVFX_FX_GREEN_SCREEN, cuStream),
-            /*.upscale = */ false,
-            /*.shaderTechnique = */ 1,
+            /*.scales = */ { 1.f },
+            /*.shaderTechnique = */ options.matteDivisor > 1 ? 3 : 1,
+            /*.settings = */ {},
+            /*.liveSettings = */ {
+                { NVVFX_MODE, "mode", "Mode", { "Quality", "Performance" }, 0, 1, uint32_t(NVVFXMode::Quality) },
+                { NVVFX_TEMPORAL, "temporal", "Temporal", { "Image", "Video" }, 0, 1, 0 },
+            },
+            /*.batchSize = */ 1,
+            /*.inputDivisor = */ options.matteDivisor,
         });
         effects.push_back({
             /*.name = */ "Artifact reduction",
+            /*.selector = */ NVVFX_FX_ARTIFACT_REDUCTION,
             /*.inputPixelFormat = */ NVCV_BGR,
             /*.inputComponentType = */ NVCV_F32,
             /*.inputLayout = */ NVCV_PLANAR,
-            /*.outputTextureFormat = */ DXGI_FORMAT_B8G8R8A8_UNORM,
+            /*.outputTextureFormat = */ DXGI_FORMAT_R32_FLOAT,
             /*.outputPixelFormat = */ NVCV_BGR,
             /*.outputComponentType = */ NVCV_F32,
             /*.outputLayout = */ NVCV_PLANAR,
-            /*.effect = */ createEffect(NVVFX_FX_ARTIFACT_REDUCTION, cuStream),
-            /*.upscale = */ false,
-            /*.shaderTechnique = */ 0,
+            /*.scales = */ { 1.f },
+            /*.shaderTechnique = */ 2,
+            /*.settings = */ {},
+            /*.liveSettings = */ {
+                { NVVFX_STRENGTH, "strength", "Strength", { "Weak", "Strong" }, 0, 1, 1 },
+            },
+            /*.batchSize = */ options.batchSize,
         });
-        if (NvVFX_SetU32(effects.back().effect, NVVFX_STRENGTH, 1) != NVCV_SUCCESS)
-        {
-            throw std::runtime_error("Failed to set strength on " + effects.back().name + " effect");
-        }
         effects.push_back({
             /*.name = */ "Super resolution",
+            /*.selector = */ NVVFX_FX_SUPER_RES,
             /*.inputPixelFormat = */ NVCV_BGR,
             /*.inputComponentType = */ NVCV_F32,
             /*.inputLayout = */ NVCV_PLANAR,
-            /*.outputTextureFormat = */ DXGI_FORMAT_B8G8R8A8_UNORM,
+            /*.outputTextureFormat = */ DXGI_FORMAT_R32_FLOAT,
             /*.outputPixelFormat = */ NVCV_BGR,
             /*.outputComponentType = */ NVCV_F32,
             /*.outputLayout = */ NVCV_PLANAR,
-            /*.effect = */ createEffect(NVVFX_FX_SUPER_RES, cuStream),
-            /*.upscale = */ true,
-            /*.shaderTechnique = */ 0,
+            /*.scales = */ { 4.f / 3, 1.5f, 2.f, 3.f, 4.f },
+            /*.shaderTechnique = */ 2,
+            /*.settings = */ {},
+            /*.liveSettings = */ {
+                { NVVFX_STRENGTH, "strength", "Strength", { "Weak", "Strong" }, 0, 1, 1 },
+            },
+            /*.batchSize = */ options.batchSize,
         });
-        if (NvVFX_SetU32(effects.back().effect, NVVFX_STRENGTH, 1) != NVCV_SUCCESS)
-        {
-            throw std::runtime_error("Failed to set strength on " + effects.back().name + " effect");
-        }
         effects.push_back({
             /*.name = */ "Upscale",
+            /*.selector = */ NVVFX_FX_SR_UPSCALE,
             /*.inputPixelFormat = */ NVCV_RGBA,
             /*.inputComponentType = */ NVCV_U8,
             /*.inputLayout = */ NVCV_CHUNKY,
@@ -491,18 +1207,103 @@ return 41;
             /*.outputPixelFormat = */ NVCV_RGBA,
             /*.outputComponentType = */ NVCV_U8,
             /*.outputLayout = */ NVCV_CHUNKY,
-            /*.effect = */ createEffect(NVVFX_FX_SR_UPSCALE, cuStream),
-            /*.upscale = */ true,
+            /*.scales = */ { 4.f / 3, 1.5f, 2.f, 3.f, 4.f },
             /*.shaderTechnique = */ 0,
+            /*.settings = */ {},
+            /*.liveSettings = */ {},
+            /*.batchSize = */ options.batchSize,
         });
+        effects.push_back({
+            /*.name = */ "Background blur",
+            /*.selector = */ NVVFX_FX_BGBLUR,
+            /*.inputPixelFormat = */ NVCV_BGR,
+            /*.inputComponentType = */ NVCV_U8,
+            /*.inputLayout = */ NVCV_CHUNKY,
+            /*.outputTextureFormat = */ DXGI_FORMAT_B8G8R8A8_UNORM,
+            /*.outputPixelFormat = */ NVCV_BGR,
+            /*.outputComponentType = */ NVCV_U8,
+            /*.outputLayout = */ NVCV_CHUNKY,
+            /*.scales = */ { 1.f },
+            /*.shaderTechnique = */ 0,
+            /*.settings = */ {},
+            /*.liveSettings = */ {},
+            /*.batchSize = */ 1,
+            /*.inputDivisor = */ 1,
+            /*.matteScene = */ greenScreenScene,
+        });
+        // Artifact reduction hands its output to Super resolution in the layout it takes, at full precision
+        effects.push_back({
+            /*.name = */ "Artifact reduction + Super resolution",
+            /*.selector = */ NVVFX_FX_ARTIFACT_REDUCTION,
+            /*.inputPixelFormat = */ NVCV_BGR,
+            /*.inputComponentType = */ NVCV_F32,
+            /*.inputLayout = */ NVCV_PLANAR,
+            /*.outputTextureFormat = */ DXGI_FORMAT_R32_FLOAT,
+            /*.outputPixelFormat = */ NVCV_BGR,
+            /*.outputComponentType = */ NVCV_F32,
+            /*.outputLayout = */ NVCV_PLANAR,
+            /*.scales = */ { 4.f / 3, 1.5f, 2.f, 3.f, 4.f },
+            /*.shaderTechnique = */ 2,
+            /*.settings = */ {},
+            /*.liveSettings = */ {
+                { NVVFX_STRENGTH, "strength", "Strength", { "Weak", "Strong" }, 0, 1, 1 },
+                { NVVFX_STRENGTH, "sr_strength", "Super resolution strength", { "Weak", "Strong" }, 0, 1, 1, 1 },
+            },
+            /*.batchSize = */ options.batchSize,
+            /*.inputDivisor = */ 1,
+            /*.matteScene = */ -1,
+            /*.chain = */ {
+                { NVVFX_FX_SUPER_RES, NVCV_BGR, NVCV_F32, NVCV_PLANAR, NVCV_BGR, NVCV_F32, NVCV_PLANAR, {} },
+            },
+        });
+        // Upscale takes 8 bit RGBA, which Artifact reduction's output is converted to on the GPU
+        effects.push_back({
+            /*.name = */ "Artifact reduction + Upscale",
+            /*.selector = */ NVVFX_FX_ARTIFACT_REDUCTION,
+            /*.inputPixelFormat = */ NVCV_BGR,
+            /*.inputComponentType = */ NVCV_F32,
+            /*.inputLayout = */ NVCV_PLANAR,
+            /*.outputTextureFormat = */ DXGI_FORMAT_R8G8B8A8_UNORM,
+            /*.outputPixelFormat = */ NVCV_BGR,
+            /*.outputComponentType = */ NVCV_F32,
+            /*.outputLayout = */ NVCV_PLANAR,
+            /*.scales = */ { 4.f / 3, 1.5f, 2.f, 3.f, 4.f },
+            /*.shaderTechnique = */ 0,
+            /*.settings = */ {},
+            /*.liveSettings = */ {
+                { NVVFX_STRENGTH, "strength", "Strength", { "Weak", "Strong" }, 0, 1, 1 },
+            },
+            /*.batchSize = */ options.batchSize,
+            /*.inputDivisor = */ 1,
+            /*.matteScene = */ -1,
+            /*.chain = */ {
+                { NVVFX_FX_SR_UPSCALE, NVCV_RGBA, NVCV_U8, NVCV_CHUNKY, NVCV_RGBA, NVCV_U8, NVCV_CHUNKY, {} },
+            },
+        });
+
+        for (Effect& effect : effects)
+        {
+            for (const EffectSetting& setting : effect.liveSettings)
+                effect.settingValues.push_back(setting.defaultValue);
+            effect.parameterData.resize(effect.liveSettings.size());
+            for (uint32_t i = 0; i < options.instances; ++i)
+                effect.instances.push_back(createInstance(effect, matteEffectOf(effect)));
+        }
     }
     catch (const std::exception& e)
     {
         tcerr << e.what() << std::endl;
-        NvVFX_CudaStreamDestroy(cuStream);
+        effects.clear();
         rs_shutdown();
         return 52;
     }
+    std::vector<std::unique_ptr<EffectInstance>> replacedInstances; // Kept until their frames in flight have been sent
+    auto destroyEffects = [&]()
+    {
+        replacedInstances.clear();
+        for (Effect& effect : effects)
+            effect.instances.clear();
+    };
 
     ScopedSchema scoped; // C++ helper that cleans up mallocs and strdups
     scoped.schema.scenes.nScenes = uint32_t(effects.size());
@@ -510,24 +1311,56 @@ return 41;
     for (size_t i = 0; i < effects.size(); ++i)
     {
         scoped.schema.scenes.scenes[i].name = _strdup(effects[i].name.c_str());
-        scoped.schema.scenes.scenes[i].nParameters = 1;
+        scoped.schema.scenes.scenes[i].nParameters = effects[i].batchSize + uint32_t(effects[i].liveSettings.size());
         scoped.schema.scenes.scenes[i].parameters = static_cast<RemoteParameter*>(malloc(scoped.schema.scenes.scenes[i].nParameters * sizeof(RemoteParameter)));
-        // Image parameter
-        scoped.schema.scenes.scenes[i].parameters[0].group = _strdup("Inputs");
-        scoped.schema.scenes.scenes[i].parameters[0].key = _strdup("image_param1");
-        scoped.schema.scenes.scenes[i].parameters[0].displayName = _strdup("Texture");
-        scoped.schema.scenes.scenes[i].parameters[0].type = RS_PARAMETER_IMAGE;
-        scoped.schema.scenes.scenes[i].parameters[0].nOptions = 0;
-        scoped.schema.scenes.scenes[i].parameters[0].options = nullptr;
-        scoped.schema.scenes.scenes[i].parameters[0].dmxOffset = -1; // Auto
-        scoped.schema.scenes.scenes[i].parameters[0].dmxType = 2; // Dmx8 = 0, Dmx16BigEndian = 2
+        for (uint32_t j = 0; j < effects[i].batchSize; ++j)
+        {
+            // Image parameter
+            const std::string index = std::to_string(j + 1);
+            scoped.schema.scenes.scenes[i].parameters[j].group = _strdup("Inputs");
+            scoped.schema.scenes.scenes[i].parameters[j].key = _strdup(("image_param" + index).c_str());
+            scoped.schema.scenes.scenes[i].parameters[j].displayName = _strdup(effects[i].batchSize > 1 ? ("Texture " + index).c_str() : "Texture");
+            scoped.schema.scenes.scenes[i].parameters[j].type = RS_PARAMETER_IMAGE;
+            scoped.schema.scenes.scenes[i].parameters[j].nOptions = 0;
+            scoped.schema.scenes.scenes[i].parameters[j].options = nullptr;
+            scoped.schema.scenes.scenes[i].parameters[j].dmxOffset = -1; // Auto
+            scoped.schema.scenes.scenes[i].parameters[j].dmxType = 2; // Dmx8 = 0, Dmx16BigEndian = 2
+        }
+        for (size_t j = 0; j < effects[i].liveSettings.size(); ++j)
+        {
+            // Numeric parameter
+            const EffectSetting& setting = effects[i].liveSettings[j];
+            RemoteParameter& parameter = scoped.schema.scenes.scenes[i].parameters[effects[i].batchSize + j];
+            parameter.group = _strdup("Effect");
+            parameter.key = _strdup(setting.key);
+            parameter.displayName = _strdup(setting.displayName);
+            parameter.type = RS_PARAMETER_NUMBER;
+            parameter.defaults.number.min = float(setting.min);
+            parameter.defaults.number.max = float(setting.max);
+            parameter.defaults.number.step = 1.f;
+            parameter.defaults.number.defaultValue = float(setting.defaultValue);
+            parameter.nOptions = uint32_t(setting.options.size());
+            parameter.options = parameter.nOptions ? static_cast<const char**>(malloc(parameter.nOptions * sizeof(const char*))) : nullptr;
+            for (uint32_t k = 0; k < parameter.nOptions; ++k)
+                parameter.options[k] = _strdup(setting.options[k]);
+            parameter.dmxOffset = -1; // Auto
+            parameter.dmxType = 2; // Dmx8 = 0, Dmx16BigEndian = 2
+        }
+    }
+
+    // Streams choose which input of a batched scene they show by channel
+    const uint32_t maxBatchSize = std::max_element(effects.begin(), effects.end(), [](const Effect& a, const Effect& b) { return a.batchSize < b.batchSize; })->batchSize;
+    if (maxBatchSize > 1)
+    {
+        scoped.schema.channels.nChannels = maxBatchSize;
+        scoped.schema.channels.channels = static_cast<const char**>(malloc(scoped.schema.channels.nChannels * sizeof(const char*)));
+        for (uint32_t i = 0; i < maxBatchSize; ++i)
+            scoped.schema.channels.channels[i] = _strdup(("Input " + std::to_string(i + 1)).c_str());
     }
     if (rs_setSchema(&scoped.schema) != RS_ERROR_SUCCESS)
     {
         tcerr << "Failed to set schema" << std::endl;
-        for (Effect& effect : effects)
-            NvVFX_DestroyEffect(effect.effect);
-        NvVFX_CudaStreamDestroy(cuStream);
+        destroyEffects();
         rs_shutdown();
         return 6;
     }
@@ -536,96 +1369,873 @@ return 41;
     if (rs_saveSchema(argv[0], &scoped.schema) != RS_ERROR_SUCCESS)
     {
         tcerr << "Failed to save schema" << std::endl;
-        for (Effect& effect : effects)
-            NvVFX_DestroyEffect(effect.effect);
-        NvVFX_CudaStreamDestroy(cuStream);
+        destroyEffects();
         rs_shutdown();
         return 61;
     }
     std::vector<uint8_t> descMem;
     const StreamDescriptions* header = nullptr;
+    // Streams with the same size, format and input show the same image, so they share a target: it is drawn once
+    // per frame and the same texture is sent to each of them
     struct RenderTarget
     {
+        uint32_t width = 0; // From the descriptions of the streams the target is shared by
+        uint32_t height = 0;
+        RSPixelFormat format = RS_FMT_BGRA8; // The texture is in the matching rsTextureFormat
+        uint32_t input = 0; // Which input of a batched scene the streams show, from their channel
         Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
-        Microsoft::WRL::ComPtr<ID3D11RenderTargetView> view;
-        Microsoft::WRL::ComPtr<ID3D11Texture2D> depth;
-        Microsoft::WRL::ComPtr<ID3D11DepthStencilView> depthView;
-    };
-    std::unordered_map<StreamHandle, RenderTarget> renderTargets;
-    Texture input;
-    std::shared_ptr<NvCVImage> effectInput;
-    Texture output;
-    std::shared_ptr<NvCVImage> effectOutput;
-    std::shared_ptr<NvCVImage> outputImage;
-    std::shared_ptr<NvCVImage> temporary = std::make_shared<NvCVImage>();
+        Microsoft::WRL::ComPtr<ID3D11RenderTargetView> view; // Only drawn to for outputs that can't be sent as they are
+        Microsoft::WRL::ComPtr<ID3D11UnorderedAccessView> uav; // Written through instead, if the device can for the format
+        ID3D11ComputeShader* outputShader = nullptr; // Which writes through (uav)
+    };
+    std::unordered_map<StreamHandle, std::shared_ptr<RenderTarget>> renderTargets;
+    // Targets for new and changed streams, created in the background while the other streams keep being sent to
+    std::future<std::vector<std::shared_ptr<RenderTarget>>> pendingTargets;
+    auto streamInput = [&scoped](const StreamDescription& description) -> uint32_t
+    {
+        for (uint32_t j = 0; j < scoped.schema.channels.nChannels; ++j)
+        {
+            if (description.channel && strcmp(description.channel, scoped.schema.channels.channels[j]) == 0)
+                return j;
+        }
+        return 0;
+    };
+    const auto targetMatches = [](const RenderTarget& target, const StreamDescription& description, uint32_t input)
+    {
+        return target.width == description.width && target.height == description.height && target.format == description.format && target.input == input;
+    };
+    // The device is free threaded, so this can run on any thread
+    // Targets are written by a compute shader if the device can write their format through an unordered access view,
+    // which not all can for every format, and drawn to otherwise
+    const bool computeOutput = options.computeOutput;
+    auto createRenderTarget = [&device, computeOutput, &outputShader, &outputFloatShader](const StreamDescription& description, uint32_t input) -> std::shared_ptr<RenderTarget>
+    {
+        auto target = std::make_shared<RenderTarget>();
+        target->width = description.width;
+        target->height = description.height;
+        target->format = description.format;
+        target->input = input;
+
+        D3D11_TEXTURE2D_DESC rtDesc;
+        ZeroMemory(&rtDesc, sizeof(D3D11_TEXTURE2D_DESC));
+        rtDesc.Width = description.width;
+        rtDesc.Height = description.height;
+        rtDesc.MipLevels = 1;
+        rtDesc.ArraySize = 1;
+        rtDesc.Format = rsTextureFormat(description.format);
+        rtDesc.SampleDesc.Count = 1;
+        rtDesc.Usage = D3D11_USAGE_DEFAULT;
+        UINT formatSupport = 0;
+        const bool unorderedAccess = computeOutput && SUCCEEDED(device->CheckFormatSupport(rtDesc.Format, &formatSupport))
+            && (formatSupport & D3D11_FORMAT_SUPPORT_TYPED_UNORDERED_ACCESS_VIEW);
+        rtDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE | (unorderedAccess ? D3D11_BIND_UNORDERED_ACCESS : 0);
+        rtDesc.CPUAccessFlags = 0;
+        rtDesc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
+        if (FAILED(device->CreateTexture2D(&rtDesc, nullptr, target->texture.GetAddressOf())))
+            throw std::runtime_error("Failed to create render target texture for stream");
+
+        D3D11_RENDER_TARGET_VIEW_DESC rtvDesc;
+        ZeroMemory(&rtvDesc, sizeof(D3D11_RENDER_TARGET_VIEW_DESC));
+        rtvDesc.Format = rtDesc.Format;
+        rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+        if (FAILED(device->CreateRenderTargetView(target->texture.Get(), &rtvDesc, target->view.GetAddressOf())))
+            throw std::runtime_error("Failed to create render target view for stream");
+
+        if (unorderedAccess)
+        {
+            target->outputShader = rtDesc.Format == DXGI_FORMAT_R32G32B32A32_FLOAT ? outputFloatShader.Get() : outputShader.Get();
+            D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+            ZeroMemory(&uavDesc, sizeof(D3D11_UNORDERED_ACCESS_VIEW_DESC));
+            uavDesc.Format = rtDesc.Format;
+            uavDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+            uavDesc.Texture2D.MipSlice = 0;
+            if (FAILED(device->CreateUnorderedAccessView(target->texture.Get(), &uavDesc, target->uav.GetAddressOf())))
+                throw std::runtime_error("Failed to create unordered access view for stream");
+        }
+
+        return target;
+    };
+    // Brings the render targets in line with the current streams. Streams that are gone or whose size, format or
+    // channel changed let go of their targets straight away, even while targets are being created, which are freed
+    // once no stream shares them. New and changed streams share an existing target if one matches; targets for the
+    // rest are created in the background and swapped in together once they are all ready, until when those streams
+    // are not sent frames. Called again whenever streams change and once the background creation finishes, which is
+    // waited for if there are no targets to send to meanwhile. Returns false if a target could not be created.
+    auto reconcileTargets = [&]() -> bool
+    {
+        const size_t numStreams = header ? header->nStreams : 0;
+        const auto findStream = [&](StreamHandle handle) -> const StreamDescription*
+        {
+            for (size_t i = 0; i < numStreams; ++i)
+            {
+                if (header->streams[i].handle == handle)
+                    return &header->streams[i];
+            }
+            return nullptr;
+        };
+        for (auto it = renderTargets.begin(); it != renderTargets.end();)
+        {
+            const StreamDescription* description = findStream(it->first);
+            if (!description || !targetMatches(*it->second, *description, streamInput(*description)))
+                it = renderTargets.erase(it);
+            else
+                ++it;
+        }
+
+        // Targets being created may be for streams that have changed again since, so are only matched to streams
+        // once they are all ready
+        std::vector<std::shared_ptr<RenderTarget>> created;
+        if (pendingTargets.valid())
+        {
+            if (!renderTargets.empty() && pendingTargets.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                return true;
+            try
+            {
+                created = pendingTargets.get();
+            }
+            catch (const std::exception& e)
+            {
+                tcerr << e.what() << std::endl;
+                return false;
+            }
+        }
+
+        std::vector<std::pair<StreamDescription, uint32_t>> missing; // One per target to create, with its input
+        for (size_t i = 0; i < numStreams; ++i)
+        {
+            const StreamDescription& description = header->streams[i];
+            if (renderTargets.find(description.handle) != renderTargets.end())
+                continue;
+
+            const uint32_t input = streamInput(description);
+            std::shared_ptr<RenderTarget> shared;
+            for (const auto& [handle, target] : renderTargets)
+            {
+                if (targetMatches(*target, description, input))
+                    shared = target;
+            }
+            for (const std::shared_ptr<RenderTarget>& target : created)
+            {
+                if (!shared && targetMatches(*target, description, input))
+                    shared = target;
+            }
+            if (shared)
+                renderTargets[description.handle] = std::move(shared);
+            else if (std::none_of(missing.begin(), missing.end(), [&](const auto& m) { return m.first.width == description.width && m.first.height == description.height && m.first.format == description.format && m.second == input; }))
+            {
+                missing.emplace_back(description, input);
+                missing.back().first.channel = nullptr; // Only valid until the streams change
+                missing.back().first.name = nullptr;
+            }
+        }
+        if (!missing.empty())
+        {
+            pendingTargets = std::async(std::launch::async, [createRenderTarget, missing]()
+            {
+                std::vector<std::shared_ptr<RenderTarget>> targets;
+                for (const auto& [description, input] : missing)
+                    targets.push_back(createRenderTarget(description, input));
+                return targets;
+            });
+        }
+        return true;
+    };
+    // Each frame in flight owns a slot, so fetching the next frame's image never overwrites
+    // textures that are still being run through an effect or sent to d3
+    struct FrameSlot
+    {
+        FrameData frameData;
+        uint32_t scene = 0;
+        EffectInstance* instance = nullptr; // The instance the frame was run on, null if drawn from a previous frame's output
+        std::shared_ptr<EffectResources> resources; // Held until the frame has been sent
+        std::shared_ptr<EffectResources> matte; // Whose output the effect took as its matte, likewise
+        bool shareMatte = false; // The instance made the matte, which is its scene's last output too, so is transferred for that scene's frames
+        std::vector<std::pair<StreamHandle, CameraResponseData>> responses; // Streams with camera data for this frame
+        CompletionEvent started{ CU_EVENT_DEFAULT }; // Recorded on the instance's stream as the effect starts, to time it
+        CompletionEvent completion{ CU_EVENT_DEFAULT }; // Recorded on the instance's stream once the effect output has been produced
+        FrameProfiler<FrameStage>::Timings timings; // Of the stages the frame has been through, committed once it retires
+    };
+    std::vector<FrameSlot> slots;
+    try
+    {
+        slots.resize(MAX_FRAMES_IN_FLIGHT);
+    }
+    catch (const std::exception& e)
+    {
+        tcerr << e.what() << std::endl;
+        destroyEffects();
+        rs_shutdown();
+        return 53;
+    }
+    std::deque<size_t> inFlight; // Indices into slots, oldest first
+    uint64_t outputCacheHits = 0; // Frames drawn from a previous frame's output
+    uint64_t outputCacheMisses = 0; // Frames run through their effect
+    uint64_t framesWithoutStreams = 0; // Frames no stream had camera data for, which are not run at all
+    FrameProfiler<FrameStage> profiler({ "Await", "Image fetch", "Transfer in", "Inference", "Wait", "Transfer out", "Refine", "Draw", "Send" }, options.profileWindow);
+    size_t nextSlot = 0;
+    uint64_t frameNumber = 0;
+
+    // Resources are cached per scene and input size, so switching back to a scene is just a lookup
+    EffectResourcesCache resourceCache(options.cacheBudgetBytes);
+    // The effect runs at (effectWidth) x (effectHeight), the input is scaled to that on the way in, and its output
+    // is (scale) times that
+    auto createResources = [&](const Effect& effect, const ImageFrameData& image, uint32_t effectWidth, uint32_t effectHeight, float scale)
+    {
+        auto resources = std::make_shared<EffectResources>();
+        resources->effectWidth = effectWidth;
+        resources->effectHeight = effectHeight;
+        resources->scale = scale;
+        uint64_t bytes = 0;
+        // Inputs are fetched in whatever format d3 has them in, and converted (and scaled) by inputShader in one pass
+        // straight into the effect's input layout, in a buffer the effect takes its input from as it is
+        if (!inputShaderWrites(effect.inputPixelFormat, effect.inputComponentType, effect.inputLayout))
+            throw std::runtime_error("No conversion to the input layout of the " + effect.name + " effect");
+        for (uint32_t i = 0; i < effect.batchSize; ++i)
+        {
+            resources->inputs.push_back(createTexture(device.Get(), image.width, image.height, rsTextureFormat(image.format)));
+            bytes += textureBytes(resources->inputs.back());
+        }
+        resources->effectInput = std::make_shared<NvCVImage>();
+        if (NvCVImage_Init(resources->effectInput.get(), effectWidth, effectHeight * effect.batchSize, 0, nullptr, effect.inputPixelFormat, effect.inputComponentType, effect.inputLayout, NVCV_GPU) != NVCV_SUCCESS)
+            throw std::runtime_error("Failed to create Nvidia CV image for " + effect.name + " effect input");
+        // Rows aligned as NvCVImage_Alloc would, which also keeps them to the 32 bit words the shader writes
+        const uint32_t rowBytes = effectWidth * resources->effectInput->pixelBytes;
+        resources->effectInput->pitch = int(effect.inputLayout == NVCV_PLANAR ? (rowBytes + 3) / 4 * 4 : (rowBytes + 31) / 32 * 32);
+        const uint32_t inputPlanes = effect.inputLayout == NVCV_PLANAR ? resources->effectInput->numComponents : 1;
+        resources->inputBuffer = createInteropBuffer(device.Get(), uint64_t(resources->effectInput->pitch) * effectHeight * inputPlanes * effect.batchSize);
+        bytes += resources->inputBuffer.bytes;
+        addToBatch(resources->inputBatch, resources->inputBuffer, resources->effectInput.get());
+
+        // Each effect of a chain but the last runs at the effect size, and passes its output to the next as it is if
+        // the next takes the same layout, or converted to the layout it takes if not
+        for (size_t i = 0; i < effect.chain.size(); ++i)
+        {
+            const ChainedEffect& chained = effect.chain[i];
+            const NvCVImage_PixelFormat format = i ? effect.chain[i - 1].outputPixelFormat : effect.outputPixelFormat;
+            const NvCVImage_ComponentType type = i ? effect.chain[i - 1].outputComponentType : effect.outputComponentType;
+            const unsigned char layout = i ? effect.chain[i - 1].outputLayout : effect.outputLayout;
+            resources->chainOutputs.push_back(std::make_shared<NvCVImage>(effectWidth, effectHeight * effect.batchSize, format, type, layout, NVCV_GPU, layout == NVCV_PLANAR ? 1 : 32));
+            bytes += imageBytes(resources->chainOutputs.back());
+            if (format == chained.inputPixelFormat && type == chained.inputComponentType && layout == chained.inputLayout)
+            {
+                resources->chainInputs.push_back(resources->chainOutputs.back());
+            }
+            else
+            {
+                resources->chainInputs.push_back(std::make_shared<NvCVImage>(effectWidth, effectHeight * effect.batchSize, chained.inputPixelFormat, chained.inputComponentType, chained.inputLayout, NVCV_GPU, chained.inputLayout == NVCV_PLANAR ? 1 : 32));
+                bytes += imageBytes(resources->chainInputs.back());
+            }
+        }
+
+        // Planar outputs are copied straight to planar textures, which the pixel shader converts as it draws
+        const ChainedEffect* last = effect.chain.empty() ? nullptr : &effect.chain.back();
+        const NvCVImage_PixelFormat outputPixelFormat = last ? last->outputPixelFormat : effect.outputPixelFormat;
+        const NvCVImage_ComponentType outputComponentType = last ? last->outputComponentType : effect.outputComponentType;
+        const unsigned char outputLayout = last ? last->outputLayout : effect.outputLayout;
+        const uint32_t width = scaledSize(effectWidth, scale);
+        const uint32_t height = scaledSize(effectHeight, scale);
+        const uint32_t outputPlanes = outputLayout == NVCV_PLANAR ? 3 : 1;
+        for (uint32_t i = 0; i < effect.batchSize; ++i)
+        {
+            resources->outputs.push_back(createTexture(device.Get(), width, height * outputPlanes, effect.outputTextureFormat));
+            shareWithCuda(resources->outputs.back());
+            bytes += textureBytes(resources->outputs.back());
+            addToBatch(resources->outputBatch, resources->outputs.back());
+        }
+        resources->effectOutput = std::make_shared<NvCVImage>(width, height * effect.batchSize, outputPixelFormat, outputComponentType, outputLayout, NVCV_GPU, outputLayout == NVCV_PLANAR ? 1 : 32);
+        if (effect.shaderTechnique == 3)
+        {
+            for (uint32_t i = 0; i < effect.batchSize; ++i)
+            {
+                resources->matteFilters.push_back(createTexture(device.Get(), width, height, DXGI_FORMAT_R32G32_FLOAT, true));
+                bytes += textureBytes(resources->matteFilters.back());
+            }
+        }
+
+        bytes += imageBytes(resources->effectOutput);
+        return std::make_pair(resources, bytes);
+    };
+    // Runs the effect on the images last set on it, which are (resources), after running the instance's own matte
+    // effect on them into (matte) if given. The input is only an image while its buffer is mapped, so it is mapped for
+    // the run and unmapped once the run is queued, and set again on the effects in between as it can be at a
+    // different address every time it is mapped.
+    auto runEffect = [&](EffectInstance& instance, EffectResources& resources, const EffectResources* matte = nullptr) -> NvCV_Status
+    {
+        if (!mapBatch(resources.inputBatch, instance.stream))
+            return NVCV_ERR_CUDA;
+        NvCV_Status status = NVCV_SUCCESS;
+        if (matte)
+        {
+            status = NvVFX_SetImage(instance.matte, NVVFX_INPUT_IMAGE, resources.effectInput.get());
+            if (status == NVCV_SUCCESS)
+                status = NvVFX_SetImage(instance.matte, NVVFX_OUTPUT_IMAGE, matte->effectOutput.get());
+            if (status == NVCV_SUCCESS)
+                status = NvVFX_Run(instance.matte, 1);
+        }
+        if (status == NVCV_SUCCESS)
+            status = NvVFX_SetImage(instance.effect, NVVFX_INPUT_IMAGE, resources.effectInput.get());
+        if (status == NVCV_SUCCESS)
+            status = NvVFX_Run(instance.effect, 1);
+        if (!unmapBatch(resources.inputBatch, instance.stream) && status == NVCV_SUCCESS)
+            status = NVCV_ERR_CUDA;
+
+        // The rest of a chain runs on images of its own, which stay in GPU memory, so only need converting where
+        // one effect's output layout differs from the next one's input layout. Planar images of a batch hold each
+        // image's planes together, so are converted an image at a time.
+        for (size_t i = 0; i < instance.chain.size() && status == NVCV_SUCCESS; ++i)
+        {
+            NvCVImage* output = resources.chainOutputs[i].get();
+            NvCVImage* input = resources.chainInputs[i].get();
+            for (unsigned n = 0; output != input && n < output->height / resources.effectHeight && status == NVCV_SUCCESS; ++n)
+            {
+                NvCVImage from, to;
+                nthImage(output, n, resources.effectHeight, &from);
+                nthImage(input, n, resources.effectHeight, &to);
+                status = NvCVImage_Transfer(&from, &to, transferScale(from, to), instance.stream, instance.temporary.get());
+            }
+            if (status == NVCV_SUCCESS)
+                status = NvVFX_Run(instance.chain[i], 1);
+        }
+        return status;
+    };
+    auto setImages = [&](EffectInstance& instance, const EffectResources& resources, const EffectResources* matte = nullptr) -> bool
+    {
+        if (NvVFX_SetImage(instance.effect, NVVFX_INPUT_IMAGE, resources.effectInput.get()) != NVCV_SUCCESS)
+        {
+            rs_logToD3("Failed to set input image\n");
+            return false;
+        }
+        // Effects of a chain each write the next one's input, and the last the output
+        const size_t chained = instance.chain.size();
+        if (NvVFX_SetImage(instance.effect, NVVFX_OUTPUT_IMAGE, (chained ? resources.chainOutputs[0] : resources.effectOutput).get()) != NVCV_SUCCESS)
+        {
+            rs_logToD3("Failed to set output image\n");
+            return false;
+        }
+        for (size_t i = 0; i < chained; ++i)
+        {
+            if (NvVFX_SetImage(instance.chain[i], NVVFX_INPUT_IMAGE, resources.chainInputs[i].get()) != NVCV_SUCCESS
+                || NvVFX_SetImage(instance.chain[i], NVVFX_OUTPUT_IMAGE, (i + 1 < chained ? resources.chainOutputs[i + 1] : resources.effectOutput).get()) != NVCV_SUCCESS)
+            {
+                rs_logToD3("Failed to set chained effect images\n");
+                return false;
+            }
+        }
+        if (matte && NvVFX_SetImage(instance.effect, NVVFX_INPUT_IMAGE_1, matte->effectOutput.get()) != NVCV_SUCCESS)
+        {
+            rs_logToD3("Failed to set matte image\n");
+            return false;
+        }
+        // The instance's own matte effect segments the same input into the matte
+        if (matte && instance.matte && (NvVFX_SetImage(instance.matte, NVVFX_INPUT_IMAGE, resources.effectInput.get()) != NVCV_SUCCESS
+            || NvVFX_SetImage(instance.matte, NVVFX_OUTPUT_IMAGE, matte->effectOutput.get()) != NVCV_SUCCESS))
+        {
+            rs_logToD3("Failed to set matte effect images\n");
+            return false;
+        }
+        // Versions of the SDK that don't take the scale factor go by the sizes of the images alone
+        if (resources.scale != 1.f)
+            NvVFX_SetF32(chained ? instance.chain.back() : instance.effect, NVVFX_SCALE, resources.scale);
+        return true;
+    };
+
+    // Shows which effects are not ready to run in d3. An effect with any instance ready can run, so only
+    // effects with none are reported.
+    auto updateStatus = [&]()
+    {
+        std::string loading, failed, updating;
+        for (const Effect& effect : effects)
+        {
+            const auto inState = [&](EffectInstance::State state) { return std::any_of(effect.instances.begin(), effect.instances.end(), [&](const auto& instance) { return instance->state == state; }); };
+            if (std::any_of(effect.instances.begin(), effect.instances.end(), [](const auto& instance) { return instance->replacement && instance->replacement->state == EffectInstance::State::Loading; }))
+                updating += (updating.empty() ? "" : ", ") + effect.name;
+            if (inState(EffectInstance::State::Ready))
+                continue;
+            if (inState(EffectInstance::State::Loading))
+                loading += (loading.empty() ? "" : ", ") + effect.name;
+            else if (inState(EffectInstance::State::Failed))
+                failed += (failed.empty() ? "" : ", ") + effect.name;
+        }
+        std::string status;
+        if (!loading.empty())
+            status = "Loading " + loading;
+        if (!failed.empty())
+            status += (status.empty() ? "" : ". ") + std::string("Failed to load ") + failed;
+        if (!updating.empty())
+            status += (status.empty() ? "" : ". ") + std::string("Applying settings to ") + updating;
+        rs_setNewStatusMessage(status.empty() ? "Ready" : status.c_str());
+    };
+    // Models are loaded on a background thread, so an instance that needs reloading doesn't hold up the others.
+    // The images the instance was given must stay alive for the load, and the instance must not be used until it is done.
+    auto startLoad = [&](EffectInstance& instance, std::shared_ptr<EffectResources> resources, std::shared_ptr<EffectResources> matte = nullptr)
+    {
+        instance.state = EffectInstance::State::Loading;
+        instance.loadedWidth = resources->effectWidth;
+        instance.loadedHeight = resources->effectHeight;
+        instance.loadedScale = resources->scale;
+        instance.loadingResources = std::move(resources);
+        instance.loadingMatte = std::move(matte);
+        NvVFX_Handle handle = instance.effect;
+        instance.loading = std::async(std::launch::async, [handle, chain = instance.chain, matte = instance.matte]()
+        {
+            NvCV_Status status = matte ? NvVFX_Load(matte) : NVCV_SUCCESS;
+            if (status == NVCV_SUCCESS)
+                status = NvVFX_Load(handle);
+            for (size_t i = 0; i < chain.size() && status == NVCV_SUCCESS; ++i)
+                status = NvVFX_Load(chain[i]);
+            return status;
+        });
+        updateStatus();
+    };
+    // Picks up the result of a background load, if it has finished (or (wait) is set). Returns true if the instance is ready.
+    auto finishLoad = [&](const Effect& effect, EffectInstance& instance, bool wait) -> bool
+    {
+        if (instance.state == EffectInstance::State::Loading && (wait || instance.loading.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+        {
+            const NvCV_Status status = instance.loading.get();
+            instance.loadingResources.reset();
+            instance.loadingMatte.reset();
+            if (status == NVCV_SUCCESS)
+            {
+                instance.state = EffectInstance::State::Ready;
+            }
+            else
+            {
+                std::stringstream ss;
+                ss << "Failed to load model for " << effect.name << " effect, status: " << status << "\n";
+                rs_logToD3(ss.str().c_str());
+                instance.state = EffectInstance::State::Failed;
+                instance.failedAt = std::chrono::steady_clock::now();
+            }
+            updateStatus();
+        }
+        return instance.state == EffectInstance::State::Ready;
+    };
+    // Waits for frames in flight on an instance, which must not be running while it is reloaded
+    auto waitForInstance = [&](const EffectInstance& instance)
+    {
+        for (size_t i : inFlight)
+        {
+            if (slots[i].instance == &instance)
+                cuEventSynchronize(slots[i].completion.event);
+        }
+    };
+    // Whether (instance) was loaded for images of (effectWidth) x (effectHeight) scaled up by (scale), so can run on them
+    const auto loadedFor = [](const EffectInstance& instance, uint32_t effectWidth, uint32_t effectHeight, float scale)
+    {
+        return instance.loadedWidth == effectWidth && instance.loadedHeight == effectHeight && instance.loadedScale == scale;
+    };
+    // Picks the instance to run the next frame for (effect) on, at (effectWidth) x (effectHeight) scaled up by (scale):
+    // a ready instance loaded for that, then one with nothing in flight, so frames run side by side, then whichever
+    // has gone longest without a frame. Returns null if no instance is ready.
+    auto scheduleInstance = [&](const Effect& effect, uint32_t effectWidth, uint32_t effectHeight, float scale) -> EffectInstance*
+    {
+        EffectInstance* scheduled = nullptr;
+        std::pair<bool, bool> scheduledRank;
+        for (const auto& instance : effect.instances)
+        {
+            if (instance->state != EffectInstance::State::Ready)
+                continue;
+            const bool idle = std::none_of(inFlight.begin(), inFlight.end(), [&](size_t i) { return slots[i].instance == instance.get() && cuEventQuery(slots[i].completion.event) == CUDA_ERROR_NOT_READY; });
+            const std::pair<bool, bool> rank(loadedFor(*instance, effectWidth, effectHeight, scale), idle);
+            if (!scheduled || rank > scheduledRank || (rank == scheduledRank && instance->lastUsed < scheduled->lastUsed))
+            {
+                scheduled = instance.get();
+                scheduledRank = rank;
+            }
+        }
+        return scheduled;
+    };
+
+    // Load every effect and run it once before accepting any frames, so models aren't loaded mid-show
+    {
+        uint32_t width = options.warmupWidth;
+        uint32_t height = options.warmupHeight;
+        try
+        {
+            std::vector<uint8_t> warmupDescMem;
+            const StreamDescriptions* streams = getStreams(rs_getStreams, warmupDescMem);
+            for (size_t i = 0; i < streams->nStreams; ++i)
+            {
+                if (i == 0 || uint64_t(streams->streams[i].width) * streams->streams[i].height > uint64_t(width) * height)
+                {
+                    width = streams->streams[i].width;
+                    height = streams->streams[i].height;
+                }
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Streams aren't known yet, use the default size
+        }
+
+        CompletionEvent warmupCompletion;
+        for (size_t i = 0; i < effects.size(); ++i)
+        {
+            Effect& effect = effects[i];
+            std::stringstream status;
+            status << "Warming up " << effect.name << " (" << (i + 1) << "/" << effects.size() << ")";
+            rs_setNewStatusMessage(status.str().c_str());
+
+            // Effects are warmed up for image parameters the size of the stream, at the size and scale frames of such
+            // images run at, so the first of them don't load the model again
+            const float scale = chooseScale(effect.scales, width, height, width, height);
+            const std::pair<uint32_t, uint32_t> effectSize = options.fitToStreams ? fitInputSize(width, height, scale, width, height) : std::make_pair(width, height);
+            ImageFrameData image;
+            image.width = width;
+            image.height = height;
+            image.format = RS_FMT_BGRA8;
+            image.imageId = 0;
+            const uint32_t effectWidth = dividedSize(effectSize.first, effect.inputDivisor);
+            const uint32_t effectHeight = dividedSize(effectSize.second, effect.inputDivisor);
+            std::shared_ptr<EffectResources> resources;
+            std::shared_ptr<EffectResources> matte; // For effects that take one, of whatever is in it
+            try
+            {
+                const EffectResourcesKey key = { uint32_t(i), image.width, image.height, rsTextureFormat(image.format), effectWidth, effectHeight, scale };
+                resources = resourceCache.acquire(key, [&]() { return createResources(effect, image, effectWidth, effectHeight, scale); });
+                if (effect.matteScene >= 0)
+                {
+                    const EffectResourcesKey matteKey = { uint32_t(effect.matteScene), image.width, image.height, key.format, effectWidth, effectHeight, 1.f };
+                    matte = resourceCache.acquire(matteKey, [&]() { return createResources(effects[effect.matteScene], image, effectWidth, effectHeight, 1.f); });
+                }
+            }
+            catch (const std::exception& e)
+            {
+                rs_logToD3((std::string(e.what()) + "\n").c_str());
+                for (auto& instance : effect.instances)
+                {
+                    instance->failedAt = std::chrono::steady_clock::now();
+                    instance->state = EffectInstance::State::Failed;
+                }
+                continue;
+            }
+
+            // Every instance loads its own copy of the model, which can happen side by side
+            for (auto& instance : effect.instances)
+            {
+                if (setImages(*instance, *resources, matte.get()))
+                {
+                    startLoad(*instance, resources, matte);
+                }
+                else
+                {
+                    instance->failedAt = std::chrono::steady_clock::now();
+                    instance->state = EffectInstance::State::Failed;
+                }
+            }
+            for (auto& instance : effect.instances)
+            {
+                if (!finishLoad(effect, *instance, true))
+                    continue;
+
+                // The first run allocates the rest of what the instance needs
+                if (runEffect(*instance, *resources, matte.get()) != NVCV_SUCCESS || cuEventRecord(warmupCompletion.event, instance->stream) != CUDA_SUCCESS || cuEventSynchronize(warmupCompletion.event) != CUDA_SUCCESS)
+                {
+                    std::stringstream ss;
+                    ss << "Failed to warm up " << effect.name << " effect\n";
+                    rs_logToD3(ss.str().c_str());
+                }
+            }
+        }
+        updateStatus();
+    }
+
+    // Draws a fullscreen quad into (target) with the pixel shader's (technique), which samples (input) and (output)
+    auto drawQuad = [&](ID3D11RenderTargetView* target, uint32_t width, uint32_t height, uint32_t technique, ID3D11ShaderResourceView* input, ID3D11ShaderResourceView* output)
+    {
+        context->OMSetRenderTargets(1, &target, nullptr);
+
+        D3D11_VIEWPORT viewport;
+        ZeroMemory(&viewport, sizeof(D3D11_VIEWPORT));
+        viewport.Width = static_cast<float>(width);
+        viewport.Height = static_cast<float>(height);
+        viewport.MinDepth = 0;
+        viewport.MaxDepth = 1;
+        context->RSSetViewports(1, &viewport);
+
+        ConstantBufferStruct constantBufferData;
+        constantBufferData.iTechnique = technique;
+        constantBufferData.iStraightAlpha = !options.premultiplyMatte;
+        context->UpdateSubresource(constantBuffer.Get(), 0, nullptr, &constantBufferData, 0, 0);
+
+        // Draw fullscreen quad
+        UINT stride = sizeof(Vertex);
+        UINT offset = 0;
+        context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+        context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        context->IASetInputLayout(inputLayout.Get());
+        context->VSSetShader(vertexShader.Get(), nullptr, 0);
+        context->PSSetShader(pixelShader.Get(), nullptr, 0);
+        context->PSSetConstantBuffers(0, 1, constantBuffer.GetAddressOf());
+        context->PSSetShaderResources(0, 1, &input);
+        context->PSSetShaderResources(1, 1, &output);
+        context->Draw(std::extent<decltype(quadVertices)>::value, 0);
+    };
+
+    // The compute version of drawQuad, for targets with an unordered access view. The constants are bound once for
+    // all the targets a frame is written to, and the shader whenever the target needs a different one from the last,
+    // only the views change from one to the next.
+    auto bindOutputStage = [&](uint32_t technique)
+    {
+        ConstantBufferStruct constantBufferData;
+        constantBufferData.iTechnique = technique;
+        constantBufferData.iStraightAlpha = !options.premultiplyMatte;
+        context->UpdateSubresource(constantBuffer.Get(), 0, nullptr, &constantBufferData, 0, 0);
+        context->CSSetConstantBuffers(0, 1, constantBuffer.GetAddressOf());
+    };
+    auto dispatchOutput = [&](ID3D11UnorderedAccessView* target, uint32_t width, uint32_t height, ID3D11ShaderResourceView* input, ID3D11ShaderResourceView* output)
+    {
+        ID3D11ShaderResourceView* views[] = { input, output };
+        context->CSSetShaderResources(0, 2, views);
+        context->CSSetUnorderedAccessViews(0, 1, &target, nullptr);
+        context->Dispatch((width + 7) / 8, (height + 7) / 8, 1);
+    };
+    // Unbinds the views, so the targets and textures can be used elsewhere
+    auto unbindOutputStage = [&]()
+    {
+        ID3D11ShaderResourceView* views[] = { nullptr, nullptr };
+        ID3D11UnorderedAccessView* target = nullptr;
+        context->CSSetShaderResources(0, 2, views);
+        context->CSSetUnorderedAccessViews(0, 1, &target, nullptr);
+    };
+
+    // Transfers the output (instance) produced in (resources) to their output textures, once it has been produced,
+    // timing it in (timings). Returns false if it could not be.
+    auto scatterOutput = [&](EffectResources& resources, const EffectInstance& instance, FrameProfiler<FrameStage>::Timings& timings) -> bool
+    {
+        // Scatter the batched output to the output textures
+        auto start = FrameProfiler<FrameStage>::Clock::now();
+        if (!mapBatch(resources.outputBatch, instance.stream))
+        {
+            rs_logToD3("Failed to map output images\n");
+            return false;
+        }
+        bool success = true;
+        for (size_t i = 0; i < resources.outputs.size() && success; ++i)
+        {
+            const Texture& output = resources.outputs[i];
+            NvCVImage outputView;
+            if (resources.effectOutput->planar == NVCV_PLANAR)
+            {
+                NvCVImage planarView;
+                nthImage(resources.effectOutput.get(), unsigned(i), output.height / resources.effectOutput->numComponents, &planarView);
+                planesAsImage(&planarView, output.image->pixelFormat, &outputView);
+            }
+            else
+            {
+                nthImage(resources.effectOutput.get(), unsigned(i), output.height, &outputView);
+            }
+
+            if (NvCVImage_Transfer(&outputView, output.image.get(), 1, instance.stream, instance.temporary.get()) != NVCV_SUCCESS)
+            {
+                rs_logToD3("Failed to transfer output image\n");
+                success = false;
+            }
+        }
+        if (!unmapBatch(resources.outputBatch, instance.stream))
+        {
+            rs_logToD3("Failed to unmap output images\n");
+            return false;
+        }
+        timings.record(FrameStage::TransferOut, start);
+
+        // Refine the mattes once, however many streams they are drawn to, and leave them refined for frames drawn
+        // from this one's output
+        if (success && !resources.matteFilters.empty())
+        {
+            start = FrameProfiler<FrameStage>::Clock::now();
+            context->CSSetShader(matteShader.Get(), nullptr, 0);
+            context->CSSetConstantBuffers(0, 1, matteFilterBuffer.GetAddressOf());
+            for (size_t i = 0; i < resources.matteFilters.size(); ++i)
+            {
+                const Texture& filter = resources.matteFilters[i];
+                ID3D11ShaderResourceView* views[] = { resources.inputs[i].srv.Get(), resources.outputs[i].srv.Get() };
+                context->CSSetShaderResources(0, 2, views);
+                context->CSSetUnorderedAccessViews(0, 1, filter.uav.GetAddressOf(), nullptr);
+                context->Dispatch((filter.width + 7) / 8, (filter.height + 7) / 8, 1);
+            }
+            unbindOutputStage();
+            timings.record(FrameStage::Refine, start);
+        }
+        return success;
+    };
+    // Frames with the same images are drawn from an effect's last output, so one that didn't reach its textures
+    // must not be: the next frame runs the effect again instead
+    auto forgetOutput = [](Effect& effect, const std::shared_ptr<EffectResources>& resources)
+    {
+        if (effect.lastOutput == resources)
+            effect.lastOutput.reset();
+    };
+    // Transfers the effect output of a frame in flight to its output textures, once the effect has produced it.
+    // Returns false if it could not be.
+    auto transferOutput = [&](FrameSlot& slot) -> bool
+    {
+        // The effect runs asynchronously, only block once its output is needed
+        const auto start = FrameProfiler<FrameStage>::Clock::now();
+        if (cuEventSynchronize(slot.completion.event) != CUDA_SUCCESS)
+        {
+            rs_logToD3("Failed to wait for effect to complete\n");
+            return false;
+        }
+        slot.timings.record(FrameStage::Wait, start);
+        float inferenceMs;
+        if (cuEventElapsedTime(&inferenceMs, slot.started.event, slot.completion.event) == CUDA_SUCCESS)
+            slot.timings.record(FrameStage::Inference, double(inferenceMs));
+
+        if (!scatterOutput(*slot.resources, *slot.instance, slot.timings))
+            return false;
+        // A matte run for this frame is drawn by frames of its own scene for the same image too, which are in
+        // flight behind this one if there are any. The effect waited for it, so it has been produced as well.
+        if (slot.shareMatte && !scatterOutput(*slot.matte, *slot.instance, slot.timings))
+            forgetOutput(effects[effects[slot.scene].matteScene], slot.matte);
+        return true;
+    };
+    // Finishes a frame in flight: transfers the effect output to its texture and draws and sends it to every
+    // stream that requested it, drawing each shared target only once. Returns false if a frame could not be sent,
+    // which is unrecoverable.
+    std::vector<const RenderTarget*> drawnTargets;
+    auto retireFrame = [&](FrameSlot& slot) -> bool
+    {
+        Effect& effect = effects[slot.scene];
+        const EffectResources& resources = *slot.resources;
+
+        // A frame drawn from a previous output has nothing to transfer, the frame that produced it was retired first
+        if (slot.instance && !transferOutput(slot))
+        {
+            forgetOutput(effect, slot.resources);
+            return true;
+        }
+
+        // Respond to frame request
+        drawnTargets.clear();
+        ID3D11ComputeShader* boundOutputShader = nullptr;
+        for (const auto& [handle, response] : slot.responses)
+        {
+            const auto it = renderTargets.find(handle);
+            if (it == renderTargets.end())
+                continue;
+
+            auto start = FrameProfiler<FrameStage>::Clock::now();
+            const RenderTarget& target = *it->second;
+            const size_t index = std::min<size_t>(target.input, resources.outputs.size() - 1);
+            const Texture& output = resources.outputs[index];
+            // A refined matte is drawn from the coefficients of its filter rather than the matte itself
+            ID3D11ShaderResourceView* const outputView = resources.matteFilters.empty() ? output.srv.Get() : resources.matteFilters[index].srv.Get();
+            D3D11_TEXTURE2D_DESC targetDesc;
+            target.texture->GetDesc(&targetDesc);
+
+            // An output that needs no compositing, resampling or conversion is sent as it is. Anything else is drawn
+            // over the whole target, so it needs no clearing first.
+            const bool direct = effect.shaderTechnique == 0 && output.width == targetDesc.Width && output.height == targetDesc.Height && effect.outputTextureFormat == targetDesc.Format;
+            if (!direct && std::find(drawnTargets.begin(), drawnTargets.end(), &target) == drawnTargets.end())
+            {
+                drawnTargets.push_back(&target);
+                if (target.uav)
+                {
+                    if (!boundOutputShader)
+                        bindOutputStage(effect.shaderTechnique);
+                    if (boundOutputShader != target.outputShader)
+                        context->CSSetShader(target.outputShader, nullptr, 0);
+                    boundOutputShader = target.outputShader;
+                    dispatchOutput(target.uav.Get(), targetDesc.Width, targetDesc.Height, resources.inputs[index].srv.Get(), outputView);
+                }
+                else
+                    drawQuad(target.view.Get(), targetDesc.Width, targetDesc.Height, effect.shaderTechnique, resources.inputs[index].srv.Get(), outputView);
+                slot.timings.record(FrameStage::Draw, start);
+            }
+
+            start = FrameProfiler<FrameStage>::Clock::now();
+            SenderFrameTypeData data;
+            data.dx11.resource = direct ? output.resource.Get() : target.texture.Get();
+            if (rs_sendFrame(handle, RS_FRAMETYPE_DX11_TEXTURE, data, &response) != RS_ERROR_SUCCESS)
+            {
+                tcerr << "Failed to send frame" << std::endl;
+                forgetOutput(effect, slot.resources);
+                return false;
+            }
+            slot.timings.record(FrameStage::Send, start);
+        }
+        if (boundOutputShader)
+            unbindOutputStage();
+        return true;
+    };
+    auto retireFrames = [&](size_t keep) -> bool
+    {
+        while (inFlight.size() > keep)
+        {
+            FrameSlot& slot = slots[inFlight.front()];
+            inFlight.pop_front();
+            const bool sent = retireFrame(slot);
+            profiler.commit(slot.timings);
+            slot.resources.reset(); // Back to the cache
+            slot.matte.reset();
+            slot.instance = nullptr;
+            slot.shareMatte = false;
+            if (!sent)
+                return false;
+        }
+        replacedInstances.erase(std::remove_if(replacedInstances.begin(), replacedInstances.end(), [&](const auto& replaced)
+            { return std::none_of(inFlight.begin(), inFlight.end(), [&](size_t i) { return slots[i].instance == replaced.get(); }); }),
+            replacedInstances.end());
+        return true;
+    };
+
+    // Whether the last output of (effect) is of (images) at (effectWidth) x (effectHeight), scaled by (scale), with
+    // the effect's current settings, so is what running the effect on them would produce again
+    const auto isLastOutput = [](const Effect& effect, const std::vector<ImageFrameData>& images, DXGI_FORMAT format, uint32_t effectWidth, uint32_t effectHeight, float scale)
+    {
+        const EffectResources* last = effect.lastOutput.get();
+        return last && effect.lastSettings == effect.settingValues
+            && last->inputs[0].width == images[0].width && last->inputs[0].height == images[0].height && last->inputs[0].format == format
+            && last->effectWidth == effectWidth && last->effectHeight == effectHeight && last->scale == scale
+            && std::equal(images.begin(), images.end(), effect.lastImageIds.begin(), effect.lastImageIds.end(), [](const ImageFrameData& a, int64_t id) { return a.imageId == id; });
+    };
+
     FrameData frameData;
-    uint32_t lastScene = 0;
     while (true)
     {
-        // Wait for a frame request
-        RS_ERROR err = rs_awaitFrameData(5000, &frameData);
+        // Push the timings of the frames retired so far
+        if (profiler.takeCommitted())
+        {
+            std::vector<ProfilingEntry>& entries = profiler.entries();
+            entries.push_back({ "Output cache hits", float(outputCacheHits) });
+            entries.push_back({ "Output cache misses", float(outputCacheMisses) });
+            entries.push_back({ "Frames without streams", float(framesWithoutStreams) });
+            rs_sendProfilingData(entries.data(), int(entries.size()));
+        }
+
+        // Swap in render targets created in the background
+        if (pendingTargets.valid() && !reconcileTargets())
+        {
+            destroyEffects();
+            rs_shutdown();
+            return 7;
+        }
+
+        // Wait for a frame request, but only briefly while there are frames in flight - if d3 isn't
+        // about to ask for another one, it is waiting on those
+        const auto awaitStart = FrameProfiler<FrameStage>::Clock::now();
+        RS_ERROR err = rs_awaitFrameData(inFlight.empty() ? 5000 : PIPELINE_POLL_MS, &frameData);
+        const double awaitMs = std::chrono::duration<double, std::milli>(FrameProfiler<FrameStage>::Clock::now() - awaitStart).count();
         if (err == RS_ERROR_STREAMS_CHANGED)
         {
+            // Frames in flight keep going: streams that are unchanged are still sent them, and streams that are
+            // gone or changed no longer have a target to be sent to
             try
             {
                 header = getStreams(rs_getStreams, descMem);
-                // Create render targets for all streams
-                const size_t numStreams = header ? header->nStreams : 0;
-                for (size_t i = 0; i < numStreams; ++i)
-                {
-                    const StreamDescription& description = header->streams[i];
-                    RenderTarget& target = renderTargets[description.handle];
-
-                    D3D11_TEXTURE2D_DESC rtDesc;
-                    ZeroMemory(&rtDesc, sizeof(D3D11_TEXTURE2D_DESC));
-                    rtDesc.Width = description.width;
-                    rtDesc.Height = description.height;
-                    rtDesc.MipLevels = 1;
-                    rtDesc.ArraySize = 1;
-                    rtDesc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
-                    rtDesc.SampleDesc.Count = 1;
-                    rtDesc.Usage = D3D11_USAGE_DEFAULT;
-                    rtDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-                    rtDesc.CPUAccessFlags = 0;
-                    rtDesc.MiscFlags = D3D11_RESOURCE_MISC_SHARED;
-                    if (FAILED(device->CreateTexture2D(&rtDesc, nullptr, target.texture.GetAddressOf())))
-                        throw std::runtime_error("Failed to create render target texture for stream");
-
-                    D3D11_RENDER_TARGET_VIEW_DESC rtvDesc;
-                    ZeroMemory(&rtvDesc, sizeof(D3D11_RENDER_TARGET_VIEW_DESC));
-                    rtvDesc.Format = rtDesc.Format;
-                    rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
-                    if (FAILED(device->CreateRenderTargetView(target.texture.Get(), &rtvDesc, target.view.GetAddressOf())))
-                        throw std::runtime_error("Failed to create render target view for stream");
-
-                    D3D11_TEXTURE2D_DESC dsDesc;
-                    ZeroMemory(&dsDesc, sizeof(D3D11_TEXTURE2D_DESC));
-                    dsDesc.Width = description.width;
-                    dsDesc.Height = description.height;
-                    dsDesc.MipLevels = 1;
-                    dsDesc.ArraySize = 1;
-                    dsDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-                    dsDesc.SampleDesc.Count = 1;
-                    dsDesc.Usage = D3D11_USAGE_DEFAULT;
-                    dsDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-                    dsDesc.CPUAccessFlags = 0;
-                    if (FAILED(device->CreateTexture2D(&dsDesc, nullptr, target.depth.GetAddressOf())))
-                        throw std::runtime_error("Failed to create depth texture for stream");
-
-                    D3D11_DEPTH_STENCIL_VIEW_DESC  dsvDesc;
-                    ZeroMemory(&dsvDesc, sizeof(D3D11_DEPTH_STENCIL_VIEW_DESC));
-                    dsvDesc.Format = dsDesc.Format;
-                    dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
-                    if (FAILED(device->CreateDepthStencilView(target.depth.Get(), &dsvDesc, target.depthView.GetAddressOf())))
-                        throw std::runtime_error("Failed to create depth view for stream");
-                }
             }
             catch (const std::exception& e)
             {
                 tcerr << e.what() << std::endl;
-                for (Effect& effect : effects)
-                    NvVFX_DestroyEffect(effect.effect);
-                NvVFX_CudaStreamDestroy(cuStream);
+                destroyEffects();
+                rs_shutdown();
+                return 7;
+            }
+            if (!reconcileTargets() || (renderTargets.empty() && !reconcileTargets()))
+            {
+                destroyEffects();
                 rs_shutdown();
                 return 7;
             }
@@ -634,6 +2244,12 @@ return 41;
         }
         else if (err == RS_ERROR_TIMEOUT)
         {
+            if (!retireFrames(0))
+            {
+                destroyEffects();
+                rs_shutdown();
+                return 8;
+            }
             continue;
         }
         else if (err != RS_ERROR_SUCCESS)
@@ -642,6 +2258,14 @@ return 41;
             break;
         }
 
+        // Make room for this frame, leaving the others in flight
+        if (!retireFrames(MAX_FRAMES_IN_FLIGHT - 1))
+        {
+            destroyEffects();
+            rs_shutdown();
+            return 8;
+        }
+
         if (frameData.scene >= scoped.schema.scenes.nScenes)
         {
             rs_logToD3("Scene out of bounds\n");
@@ -650,100 +2274,315 @@ return 41;
 
         const auto& scene = scoped.schema.scenes.scenes[frameData.scene];
         Effect& effect = effects[frameData.scene];
+        FrameSlot& slot = slots[nextSlot];
+        // A frame skipped before it went in flight leaves its timings behind, they are never committed
+        slot.timings.clear();
+        slot.timings.record(FrameStage::Await, awaitMs);
+
+        // Plan the frame before doing any work for it: only streams with camera data for this frame are sent it,
+        // and camera data is only available until the next rs_awaitFrameData, so collect it while this frame is
+        // current. A frame no stream wants is not run at all.
+        slot.responses.clear();
+        uint32_t planWidth = 0, planHeight = 0; // Covers every stream the frame is sent to
+        const size_t numStreams = header ? header->nStreams : 0;
+        for (size_t i = 0; i < numStreams; ++i)
+        {
+            const StreamDescription& description = header->streams[i];
+            if (renderTargets.find(description.handle) == renderTargets.end())
+                continue;
 
-        ImageFrameData image;
-        if (rs_getFrameImageData(scene.hash, &image, 1) != RS_ERROR_SUCCESS)
+            CameraResponseData response;
+            response.tTracked = frameData.tTracked;
+            if (rs_getFrameCamera(description.handle, &response.camera) == RS_ERROR_SUCCESS)
+            {
+                slot.responses.emplace_back(description.handle, response);
+                planWidth = std::max(planWidth, description.width);
+                planHeight = std::max(planHeight, description.height);
+            }
+        }
+        if (slot.responses.empty())
         {
-            rs_logToD3("Failed to get image parameter data\n");;
+            ++framesWithoutStreams;
             continue;
         }
-        if (input.width != image.width || input.height != image.height || frameData.scene != lastScene)
+
+        // Effect settings can change from frame to frame; a change is applied by loading replacement instances in
+        // the background, frames keep running on the current ones with the old settings until then
+        if (!effect.liveSettings.empty())
         {
-            input = createTexture(device.Get(), image.width, image.height, DXGI_FORMAT_B8G8R8A8_UNORM);
-            effectInput = std::make_shared<NvCVImage>(image.width, image.height, effect.inputPixelFormat, effect.inputComponentType, effect.inputLayout, NVCV_GPU, effect.inputLayout == NVCV_PLANAR ? 1 : 32);
+            if (rs_getFrameParameters(scene.hash, effect.parameterData.data(), effect.parameterData.size() * sizeof(float)) == RS_ERROR_SUCCESS)
+            {
+                for (size_t i = 0; i < effect.liveSettings.size(); ++i)
+                    effect.settingValues[i] = settingValue(effect.liveSettings[i], effect.parameterData[i]);
+            }
+            else
+            {
+                rs_logToD3("Failed to get parameter data\n");
+            }
         }
 
-        SenderFrameTypeData data;
-        data.dx11.resource = input.resource.Get();
+        // Run on a ready instance, and retry one instance that failed to load once it is time to.
+        // The scene is skipped while none of its instances are ready.
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& candidate : effect.instances)
+        {
+            finishLoad(effect, *candidate, false);
 
-        if (rs_getFrameImage(image.imageId, RS_FRAMETYPE_DX11_TEXTURE, data) != RS_ERROR_SUCCESS)
+            EffectInstance* replacement = candidate->replacement.get();
+            if (replacement && replacement->state == EffectInstance::State::Loading && finishLoad(effect, *replacement, false))
+            {
+                // The first run allocates the rest of what the instance needs, it takes no frames until that is done
+                if (runEffect(*replacement, *replacement->warmupResources, replacement->warmupMatte.get()) != NVCV_SUCCESS || cuEventRecord(replacement->warmedUp->event, replacement->stream) != CUDA_SUCCESS)
+                {
+                    std::stringstream ss;
+                    ss << "Failed to warm up " << effect.name << " effect\n";
+                    rs_logToD3(ss.str().c_str());
+                }
+            }
+            if (replacement && replacement->state == EffectInstance::State::Ready && cuEventQuery(replacement->warmedUp->event) != CUDA_ERROR_NOT_READY)
+            {
+                replacement->warmupResources.reset();
+                replacement->warmupMatte.reset();
+                replacedInstances.push_back(std::move(candidate));
+                candidate = std::move(replacedInstances.back()->replacement);
+                updateStatus();
+            }
+        }
+        EffectInstance* reload = nullptr;
+        for (auto& candidate : effect.instances)
         {
-            rs_logToD3("Failed to get image parameter\n");
-            continue;
+            if (candidate->state == EffectInstance::State::Failed && now - candidate->failedAt >= RELOAD_RETRY_INTERVAL)
+            {
+                reload = candidate.get();
+                break;
+            }
         }
 
-        bool success = true;
-        if (NvCVImage_MapResource(input.image.get(), cuStream) != NVCV_SUCCESS)
+        auto start = FrameProfiler<FrameStage>::Clock::now();
+        std::vector<ImageFrameData> images(effect.batchSize);
+        if (rs_getFrameImageData(scene.hash, images.data(), images.size()) != RS_ERROR_SUCCESS)
         {
-            rs_logToD3("Failed to map input image\n");
+            rs_logToD3("Failed to get image parameter data\n");;
             continue;
         }
-        if (NvCVImage_Transfer(input.image.get(), effectInput.get(), 1/255.f, cuStream, temporary.get()) != NVCV_SUCCESS)
+        const ImageFrameData& image = images[0];
+        if (std::any_of(images.begin(), images.end(), [&](const ImageFrameData& other) { return other.width != image.width || other.height != image.height || other.format != image.format; }))
         {
-            rs_logToD3("Failed to transfer input image\n");
-            success = false;
+            rs_logToD3("Batched image parameters must all be the same size and format\n");
+            continue;
         }
-        if (NvCVImage_UnmapResource(input.image.get(), cuStream) != NVCV_SUCCESS)
+        // Effects that scale up do so by the factor that gets closest to the largest stream the frame is sent to, and
+        // run at the smallest size that, once scaled up, covers it. Mattes refined against the input run at a fraction
+        // of that.
+        const float wantedScale = chooseScale(effect.scales, image.width, image.height, planWidth, planHeight);
+        const std::pair<uint32_t, uint32_t> effectSize = options.fitToStreams ? fitInputSize(image.width, image.height, wantedScale, planWidth, planHeight) : std::make_pair(image.width, image.height);
+        const EffectResourcesKey wanted = { frameData.scene, image.width, image.height, rsTextureFormat(image.format),
+            dividedSize(effectSize.first, effect.inputDivisor), dividedSize(effectSize.second, effect.inputDivisor), wantedScale };
+
+        // Models are loaded for the size they run at and the factor they scale up by as well as for their settings,
+        // so instances loaded for another size or settings are replaced by ones loaded in the background for these.
+        // Until then frames run at the size and scale the instance was loaded for, and the difference to the streams
+        // is made up as the output is drawn.
+        Effect* matteEffect = matteEffectOf(effect);
+        const auto loadedWithSettings = [&](const EffectInstance& candidate)
         {
-            rs_logToD3("Failed to unmap input image\n");
-            continue;
+            return candidate.settings == effect.settingValues && (!matteEffect || candidate.matteSettings == matteEffect->settingValues);
+        };
+        EffectInstance* instance = scheduleInstance(effect, wanted.effectWidth, wanted.effectHeight, wanted.scale);
+        EffectInstance* outdated = nullptr; // A ready instance to load a replacement for
+        for (auto& candidate : effect.instances)
+        {
+            if (candidate->state != EffectInstance::State::Ready || (loadedWithSettings(*candidate) && loadedFor(*candidate, wanted.effectWidth, wanted.effectHeight, wanted.scale)))
+                continue;
+            const EffectInstance* pending = candidate->replacement.get();
+            if (!pending || (pending->state == EffectInstance::State::Failed && (!loadedWithSettings(*pending)
+                || !loadedFor(*pending, wanted.effectWidth, wanted.effectHeight, wanted.scale) || now - pending->failedAt >= RELOAD_RETRY_INTERVAL)))
+            {
+                outdated = candidate.get();
+                break;
+            }
         }
-        if (!success)
+        EffectResourcesKey key = wanted;
+        if (instance && !loadedFor(*instance, wanted.effectWidth, wanted.effectHeight, wanted.scale))
+        {
+            key.effectWidth = instance->loadedWidth;
+            key.effectHeight = instance->loadedHeight;
+            key.scale = instance->loadedScale;
+        }
+        const uint32_t effectWidth = key.effectWidth;
+        const uint32_t effectHeight = key.effectHeight;
+        const float scale = key.scale;
+
+        // Stills and paused media keep their image ids, and with the same settings the effect would produce the
+        // same output again, so the frame is drawn from the last one without fetching or running anything. The
+        // frame that produced it is in flight ahead of this one or has been sent already.
+        const bool unchanged = isLastOutput(effect, images, key.format, effectWidth, effectHeight, scale)
+            && (!matteEffect || effect.lastMatteSettings == matteEffect->settingValues);
+        if (unchanged)
+        {
+            ++outputCacheHits;
+            slot.frameData = frameData;
+            slot.scene = frameData.scene;
+            slot.instance = nullptr;
+            slot.resources = effect.lastOutput;
+            inFlight.push_back(nextSlot);
+            nextSlot = (nextSlot + 1) % slots.size();
             continue;
+        }
 
-        if (NvVFX_SetImage(effect.effect, NVVFX_INPUT_IMAGE, effectInput.get()) != NVCV_SUCCESS)
+        if (!instance && !reload)
+            continue;
+        std::shared_ptr<EffectResources> resources;
+        try
         {
-            rs_logToD3("Failed to set input image\n");
+            resources = resourceCache.acquire(key, [&]() { return createResources(effect, image, effectWidth, effectHeight, scale); });
+        }
+        catch (const std::exception& e)
+        {
+            rs_logToD3((std::string(e.what()) + "\n").c_str());
             continue;
         }
-
-        // Run effect
-        const uint32_t width = effect.upscale ? image.width * 2 : image.width;
-        const uint32_t height = effect.upscale ? image.height * 2 : image.height;
-        if (output.width != width || output.height != height || frameData.scene != lastScene)
-        {
-            output = createTexture(device.Get(), width, height, effect.outputTextureFormat);
-            effectOutput = std::make_shared<NvCVImage>(width, height, effect.outputPixelFormat, effect.outputComponentType, effect.outputLayout, NVCV_GPU, effect.outputLayout == NVCV_PLANAR ? 1 : 32);
-
-            // See if we need to manually transfer effect output as NvCVImage_Transfer is missing planar->DX11 conversions
-            NvCVImage_PixelFormat outputPixelFormat;
-            NvCVImage_ComponentType outputComponentType;
-            unsigned char outputLayout;
-            if (NvCVImage_FromD3DFormat(effect.outputTextureFormat, &outputPixelFormat, &outputComponentType, &outputLayout) != NVCV_SUCCESS)
-            {
-                tcerr << "Failed to determine output image format" << std::endl;
-                for (Effect& effect : effects)
-                    NvVFX_DestroyEffect(effect.effect);
-                NvVFX_CudaStreamDestroy(cuStream);
-                rs_shutdown();
-                return 84;
+        bool fetched = true;
+        for (size_t i = 0; i < images.size() && fetched; ++i)
+        {
+            SenderFrameTypeData data;
+            data.dx11.resource = resources->inputs[i].resource.Get();
+            fetched = rs_getFrameImage(images[i].imageId, RS_FRAMETYPE_DX11_TEXTURE, data) == RS_ERROR_SUCCESS;
+        }
+        if (!fetched)
+        {
+            rs_logToD3("Failed to get image parameter\n");
+            continue;
+        }
+        slot.timings.record(FrameStage::Fetch, start);
+
+        // An effect that takes a matte takes the one its matte scene's effect last produced if that is of the same
+        // image at the same size and settings, as that scene's own frames would be drawn from. Otherwise the
+        // instance's own matte effect segments this effect's input as it is, and its output becomes that scene's
+        // last output in turn, so whichever of the two scenes comes first segments the image for both.
+        std::shared_ptr<EffectResources> matte;
+        bool ownMatte = false;
+        if (matteEffect)
+        {
+            if (instance && isLastOutput(*matteEffect, images, key.format, effectWidth, effectHeight, 1.f))
+            {
+                matte = matteEffect->lastOutput;
             }
-            if (effect.outputPixelFormat != outputPixelFormat || effect.outputComponentType != outputComponentType || effect.outputLayout != outputLayout)
-                outputImage = std::make_shared<NvCVImage>(width, height, outputPixelFormat, outputComponentType, outputLayout, NVCV_GPU, outputLayout == NVCV_PLANAR ? 1 : 32);
             else
-                outputImage = effectOutput;
+            {
+                try
+                {
+                    const EffectResourcesKey matteKey = { uint32_t(effect.matteScene), image.width, image.height, key.format, effectWidth, effectHeight, 1.f };
+                    matte = resourceCache.acquire(matteKey, [&]() { return createResources(*matteEffect, image, effectWidth, effectHeight, 1.f); });
+                }
+                catch (const std::exception& e)
+                {
+                    rs_logToD3((std::string(e.what()) + "\n").c_str());
+                    continue;
+                }
+                ownMatte = true;
+            }
         }
 
-        if (NvVFX_SetImage(effect.effect, NVVFX_OUTPUT_IMAGE, effectOutput.get()) != NVCV_SUCCESS)
+        if (reload && setImages(*reload, *resources, matte.get()))
         {
-            tcerr << "Failed to set output image" << std::endl;
-            for (Effect& effect : effects)
-                NvVFX_DestroyEffect(effect.effect);
-            NvVFX_CudaStreamDestroy(cuStream);
-            rs_shutdown();
-            return 84;
+            waitForInstance(*reload);
+            applySettings(effect, *reload);
+            if (matteEffect)
+                applyMatteSettings(*matteEffect, *reload);
+            startLoad(*reload, resources, matte);
         }
+        if (outdated)
+        {
+            // The replacement warms up once loaded, which needs images of its own; these are in use by this frame
+            try
+            {
+                std::unique_ptr<EffectInstance> replacement = createInstance(effect, matteEffect);
+                replacement->warmupResources = resourceCache.acquire(wanted, [&]() { return createResources(effect, image, wanted.effectWidth, wanted.effectHeight, wanted.scale); });
+                if (matteEffect)
+                {
+                    const EffectResourcesKey matteKey = { uint32_t(effect.matteScene), image.width, image.height, wanted.format, wanted.effectWidth, wanted.effectHeight, 1.f };
+                    replacement->warmupMatte = resourceCache.acquire(matteKey, [&]() { return createResources(*matteEffect, image, wanted.effectWidth, wanted.effectHeight, 1.f); });
+                }
+                if (setImages(*replacement, *replacement->warmupResources, replacement->warmupMatte.get()))
+                {
+                    startLoad(*replacement, replacement->warmupResources, replacement->warmupMatte);
+                }
+                else
+                {
+                    replacement->warmupResources.reset();
+                    replacement->warmupMatte.reset();
+                    replacement->failedAt = now;
+                    replacement->state = EffectInstance::State::Failed;
+                }
+                outdated->replacement = std::move(replacement);
+            }
+            catch (const std::exception& e)
+            {
+                rs_logToD3((std::string(e.what()) + "\n").c_str());
+            }
+        }
+        if (!instance)
+            continue;
 
-        if (!effect.loaded && NvVFX_Load(effect.effect) != NVCV_SUCCESS)
+        // Convert (and scale) the inputs straight into the effect input in one pass each, which the effect waits for
+        // when it maps the input
+        start = FrameProfiler<FrameStage>::Clock::now();
+        const NvCVImage& effectInput = *resources->effectInput;
+        const bool planarInput = effectInput.planar == NVCV_PLANAR;
+        context->CSSetShader(inputShader.Get(), nullptr, 0);
+        context->CSSetConstantBuffers(0, 1, inputLayoutBuffer.GetAddressOf());
+        context->CSSetUnorderedAccessViews(0, 1, resources->inputBuffer.uav.GetAddressOf(), nullptr);
+        for (size_t i = 0; i < resources->inputs.size(); ++i)
         {
-            rs_logToD3("Failed to load model\n");
+            InputLayoutStruct layout = {};
+            layout.width = resources->effectWidth;
+            layout.height = resources->effectHeight;
+            layout.pitch = uint32_t(effectInput.pitch);
+            layout.offset = uint32_t(i * effectInput.pitch * resources->effectHeight * (planarInput ? effectInput.numComponents : 1));
+            layout.planar = planarInput;
+            layout.components = effectInput.numComponents;
+            layout.redFirst = effectInput.pixelFormat == NVCV_RGB || effectInput.pixelFormat == NVCV_RGBA;
+            context->UpdateSubresource(inputLayoutBuffer.Get(), 0, nullptr, &layout, 0, 0);
+            context->CSSetShaderResources(0, 1, resources->inputs[i].srv.GetAddressOf());
+            const uint32_t columns = planarInput ? layout.width : (layout.width * layout.components + 3) / 4;
+            context->Dispatch((columns + 7) / 8, (layout.height + 7) / 8, 1);
+        }
+        ID3D11ShaderResourceView* const nullSrv = nullptr;
+        ID3D11UnorderedAccessView* const nullUav = nullptr;
+        context->CSSetShaderResources(0, 1, &nullSrv);
+        context->CSSetUnorderedAccessViews(0, 1, &nullUav, nullptr);
+        slot.timings.record(FrameStage::TransferIn, start);
+
+        // The matte never leaves the GPU: one made here is made on this effect's stream, and this effect's stream
+        // just waits for the matte scene's own.
+        bool shareMatte = false;
+        if (ownMatte)
+        {
+            // Frames of a matte scene that runs at a fraction of the size never run at this one
+            shareMatte = matteEffect->inputDivisor == 1;
+            if (shareMatte)
+                context->CopyResource(matte->inputs[0].resource.Get(), resources->inputs[0].resource.Get()); // For its frames to composite over
+        }
+        else if (matte && cuStreamWaitEvent(instance->stream, matte->produced.event, 0) != CUDA_SUCCESS)
+        {
+            rs_logToD3("Failed to wait for matte\n");
             continue;
         }
-        effect.loaded = true;
 
-        NvCV_Status status = NvVFX_Run(effect.effect, 0);
+        if (!setImages(*instance, *resources, matte.get()))
+            continue;
+
+        // Run effect
+        instance->lastUsed = ++frameNumber;
+        cuEventRecord(slot.started.event, instance->stream);
+        NvCV_Status status = runEffect(*instance, *resources, ownMatte ? matte.get() : nullptr);
         if (status == NVCV_ERR_INITIALIZATION)
-            effect.loaded = false; // Attempt reinitialisation
+        {
+            // Attempt reinitialisation
+            waitForInstance(*instance);
+            startLoad(*instance, resources, matte);
+        }
         if (status != NVCV_SUCCESS)
         {
             std::stringstream ss;
@@ -752,92 +2591,39 @@ return 41;
             continue;
         }
 
-        if (effectOutput != outputImage && NvCVImage_Transfer(effectOutput.get(), outputImage.get(), 255.f, cuStream, temporary.get()) != NVCV_SUCCESS)
+        if (cuEventRecord(slot.completion.event, instance->stream) != CUDA_SUCCESS || cuEventRecord(resources->produced.event, instance->stream) != CUDA_SUCCESS
+            || (ownMatte && cuEventRecord(matte->produced.event, instance->stream) != CUDA_SUCCESS))
         {
-            rs_logToD3("Failed to transfer effect output to output image\n");
+            rs_logToD3("Failed to record effect completion\n");
             continue;
         }
 
-        success = true;
-        if (NvCVImage_MapResource(output.image.get(), cuStream) != NVCV_SUCCESS)
-        {
-            rs_logToD3("Failed to map output image\n");
-            continue;
-        }
-        if (NvCVImage_Transfer(outputImage.get(), output.image.get(), 1, cuStream, temporary.get()) != NVCV_SUCCESS)
-        {
-            rs_logToD3("Failed to transfer output image\n");
-            success = false;
-        }
-        if (NvCVImage_UnmapResource(output.image.get(), cuStream) != NVCV_SUCCESS)
+        ++outputCacheMisses;
+        effect.lastOutput = resources;
+        effect.lastImageIds.resize(images.size());
+        std::transform(images.begin(), images.end(), effect.lastImageIds.begin(), [](const ImageFrameData& data) { return data.imageId; });
+        effect.lastSettings = instance->settings;
+        if (shareMatte)
         {
-            rs_logToD3("Failed to unmap output image\n");
-            continue;
-        }
-        if (!success)
-            continue;
-
-        // Respond to frame request
-        const size_t numStreams = header ? header->nStreams : 0;
-        for (size_t i = 0; i < numStreams; ++i)
-        {
-            const StreamDescription& description = header->streams[i];
-
-            CameraResponseData response;
-            response.tTracked = frameData.tTracked;
-            if (rs_getFrameCamera(description.handle, &response.camera) == RS_ERROR_SUCCESS)
-            {
-                const RenderTarget& target = renderTargets.at(description.handle);
-                context->OMSetRenderTargets(1, target.view.GetAddressOf(), target.depthView.Get());
-
-                const float clearColour[4] = { 0.f, 0.f, 0.f, 0.f };
-                context->ClearRenderTargetView(target.view.Get(), clearColour);
-                context->ClearDepthStencilView(target.depthView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
-
-                D3D11_VIEWPORT viewport;
-                ZeroMemory(&viewport, sizeof(D3D11_VIEWPORT));
-                viewport.Width = static_cast<float>(description.width);
-                viewport.Height = static_cast<float>(description.height);
-                viewport.MinDepth = 0;
-                viewport.MaxDepth = 1;
-                context->RSSetViewports(1, &viewport);
-
-                ConstantBufferStruct constantBufferData;
-                constantBufferData.iTechnique = effect.shaderTechnique;
-                context->UpdateSubresource(constantBuffer.Get(), 0, nullptr, &constantBufferData, 0, 0);
-
-                // Draw fullscreen quad
-                UINT stride = sizeof(Vertex);
-                UINT offset = 0;
-                context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-                context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-                context->IASetInputLayout(inputLayout.Get());
-                context->VSSetShader(vertexShader.Get(), nullptr, 0);
-                context->PSSetShader(pixelShader.Get(), nullptr, 0);
-                context->PSSetConstantBuffers(0, 1, constantBuffer.GetAddressOf());
-                context->PSSetShaderResources(0, 1, input.srv.GetAddressOf());
-                context->PSSetShaderResources(1, 1, output.srv.GetAddressOf());
-                context->Draw(std::extent<decltype(quadVertices)>::value, 0);
-
-                SenderFrameTypeData data;
-                data.dx11.resource = target.texture.Get();
-                if (rs_sendFrame(description.handle, RS_FRAMETYPE_DX11_TEXTURE, data, &response) != RS_ERROR_SUCCESS)
-                {
-                    tcerr << "Failed to send frame" << std::endl;
-                    for (Effect& effect : effects)
-                        NvVFX_DestroyEffect(effect.effect);
-                    NvVFX_CudaStreamDestroy(cuStream);
-                    rs_shutdown();
-                    return 8;
-                }
-            }
+            matteEffect->lastOutput = matte;
+            matteEffect->lastImageIds = effect.lastImageIds;
+            matteEffect->lastSettings = instance->matteSettings;
         }
-        lastScene = frameData.scene;
+        if (matte)
+            effect.lastMatteSettings = ownMatte ? instance->matteSettings : matteEffect->lastSettings;
+
+        // Leave the frame in flight; it is sent once the next frame has been fetched or d3 stops asking
+        slot.frameData = frameData;
+        slot.scene = frameData.scene;
+        slot.instance = instance;
+        slot.resources = std::move(resources);
+        slot.matte = std::move(matte);
+        slot.shareMatte = shareMatte;
+        inFlight.push_back(nextSlot);
+        nextSlot = (nextSlot + 1) % slots.size();
     }
 
-    for (Effect& effect : effects)
-        NvVFX_DestroyEffect(effect.effect);
-    NvVFX_CudaStreamDestroy(cuStream);
+    destroyEffects();
 
     if (rs_shutdown() != RS_ERROR_SUCCESS)
     {
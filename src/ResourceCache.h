@@ -0,0 +1,115 @@
+// A cache of GPU resources keyed by what they were created for, so switching back to a scene (or
+// resolution) that was recently used is a lookup rather than a round of allocations.
+//
+// A resource is in use while anything other than the cache holds a reference to it; in-use resources
+// are never handed out twice or evicted. Idle resources are evicted least recently used first whenever
+// the total size of the cache exceeds its budget.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+
+template <typename Key, typename Resource, typename KeyHash = std::hash<Key>>
+class ResourceCache
+{
+public:
+    explicit ResourceCache(uint64_t budgetBytes)
+        : m_budgetBytes(budgetBytes)
+    {
+    }
+
+    ResourceCache(const ResourceCache&) = delete;
+    ResourceCache& operator=(const ResourceCache&) = delete;
+
+    // Returns an idle resource created for (key), or calls (create) to make a new one. (create) returns a
+    // std::pair<std::shared_ptr<Resource>, uint64_t> of the resource and its size in bytes, and may throw.
+    template <typename Create>
+    std::shared_ptr<Resource> acquire(const Key& key, Create&& create)
+    {
+        const auto range = m_index.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const auto entry = it->second;
+            if (entry->resource.use_count() == 1)
+            {
+                m_entries.splice(m_entries.begin(), m_entries, entry);
+                ++m_hits;
+                return entry->resource;
+            }
+        }
+
+        ++m_misses;
+        auto created = create();
+        m_entries.push_front({ key, std::move(created.first), created.second });
+        m_index.emplace(key, m_entries.begin());
+        m_bytes += created.second;
+        std::shared_ptr<Resource> resource = m_entries.front().resource;
+        evict();
+        return resource;
+    }
+
+    void setBudget(uint64_t budgetBytes)
+    {
+        m_budgetBytes = budgetBytes;
+        evict();
+    }
+
+    // Drops every idle resource
+    void clear()
+    {
+        const uint64_t budgetBytes = m_budgetBytes;
+        setBudget(0);
+        m_budgetBytes = budgetBytes;
+    }
+
+    uint64_t bytes() const { return m_bytes; }
+    uint64_t budget() const { return m_budgetBytes; }
+    uint64_t hits() const { return m_hits; }
+    uint64_t misses() const { return m_misses; }
+    uint64_t evictions() const { return m_evictions; }
+
+private:
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<Resource> resource;
+        uint64_t bytes;
+    };
+    using EntryList = std::list<Entry>; // Most recently used first
+
+    void evict()
+    {
+        auto entry = m_entries.end();
+        while (m_bytes > m_budgetBytes && entry != m_entries.begin())
+        {
+            --entry;
+            if (entry->resource.use_count() != 1)
+                continue;
+
+            const auto range = m_index.equal_range(entry->key);
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                if (it->second == entry)
+                {
+                    m_index.erase(it);
+                    break;
+                }
+            }
+            m_bytes -= entry->bytes;
+            ++m_evictions;
+            entry = m_entries.erase(entry);
+        }
+    }
+
+    EntryList m_entries;
+    std::unordered_multimap<Key, typename EntryList::iterator, KeyHash> m_index;
+    uint64_t m_budgetBytes;
+    uint64_t m_bytes = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+    uint64_t m_evictions = 0;
+};
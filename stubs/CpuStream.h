@@ -0,0 +1,143 @@
+// A CPU stand-in for a CUDA stream: work is queued and run in submission order on a worker thread,
+// so code that relies on stream ordering and event completion can run without a GPU.
+//
+// Work queued by the NvVFX and NvCVImage stand-ins runs on the stream, and the CUDA event
+// stand-in in CudaStub.cpp records a marker into it.
+
+#pragma once
+
+#include "Stubs.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+class CpuStream
+{
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable workCompleted;
+        std::condition_variable workAvailable;
+        std::deque<std::function<void()>> work;
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        bool stop = false;
+    };
+
+public:
+    // A point in the stream's work, which can be waited for after the stream has been destroyed, as a Cuda event
+    // can: the stream finishes the work queued on it before it goes. Default constructed markers are complete.
+    class Marker
+    {
+    public:
+        Marker() = default;
+
+        bool isComplete() const
+        {
+            if (!m_state)
+                return true;
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            return m_state->completed >= m_ticket;
+        }
+
+        void wait() const
+        {
+            if (!m_state)
+                return;
+            std::unique_lock<std::mutex> lock(m_state->mutex);
+            m_state->workCompleted.wait(lock, [&]() { return m_state->completed >= m_ticket; });
+        }
+
+    private:
+        friend class CpuStream;
+        Marker(std::shared_ptr<State> state, uint64_t ticket)
+            : m_state(std::move(state))
+            , m_ticket(ticket)
+        {
+        }
+
+        std::shared_ptr<State> m_state;
+        uint64_t m_ticket = 0;
+    };
+
+    CpuStream()
+        : m_state(std::make_shared<State>())
+        , m_worker([state = m_state]() { run(*state); })
+    {
+    }
+    ~CpuStream()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            m_state->stop = true;
+        }
+        m_state->workAvailable.notify_one();
+        m_worker.join();
+    }
+
+    CpuStream(const CpuStream&) = delete;
+    CpuStream& operator=(const CpuStream&) = delete;
+
+    // Queue work behind everything already on the stream, returning a marker that completes with it
+    Marker enqueue(std::function<void()> work)
+    {
+        StubHeapScope heapScope;
+        uint64_t ticket;
+        {
+            std::lock_guard<std::mutex> lock(m_state->mutex);
+            m_state->work.push_back(std::move(work));
+            ticket = ++m_state->submitted;
+        }
+        m_state->workAvailable.notify_one();
+        return Marker(m_state, ticket);
+    }
+
+    // A marker that completes once the work queued on the stream so far has
+    Marker mark()
+    {
+        return enqueue([]() {});
+    }
+
+    void synchronize() const
+    {
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        m_state->workCompleted.wait(lock, [&]() { return m_state->completed >= m_state->submitted; });
+    }
+
+private:
+    // Runs until the stream is destroyed, finishing the work queued on it first
+    static void run(State& state)
+    {
+        StubHeapScope heapScope;
+        std::unique_lock<std::mutex> lock(state.mutex);
+        while (true)
+        {
+            state.workAvailable.wait(lock, [&]() { return state.stop || !state.work.empty(); });
+            if (state.work.empty())
+                return;
+
+            std::function<void()> work = std::move(state.work.front());
+            state.work.pop_front();
+            lock.unlock();
+            work();
+            lock.lock();
+            ++state.completed;
+            state.workCompleted.notify_all();
+        }
+    }
+
+    std::shared_ptr<State> m_state; // Shared with the markers handed out
+    std::thread m_worker;
+};
+
+// Streams handed out as CUstream by the stand-ins are CpuStream objects
+inline CpuStream* toCpuStream(struct CUstream_st* stream)
+{
+    return reinterpret_cast<CpuStream*>(stream);
+}
@@ -0,0 +1,203 @@
+// CPU stand-in for the CUDA driver API subset in src/CudaProxy.h. Link this instead of CudaProxy.cpp;
+// streams passed to it must come from the NvVFX stand-in's NvVFX_CudaStreamCreate (CpuStream objects), and
+// resources registered with it must be the D3D11 stand-in's textures or buffers, whose arrays and pointers are
+// their host memory.
+
+#include "win32/d3d11.h"
+#include "../src/CudaProxy.h"
+#include "CpuStream.h"
+#include "Stubs.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+struct CUevent_st
+{
+    // Written by the stream, which may outlive the event or be destroyed before it, as Cuda streams can
+    struct Record
+    {
+        std::atomic<bool> complete{ false };
+        std::chrono::steady_clock::time_point completedAt; // When the stream reached the event, once it has
+    };
+
+    unsigned int flags = 0;
+    CpuStream::Marker marker; // Where the event was last recorded, if it has been
+    std::shared_ptr<Record> record;
+};
+
+CUresult cuEventCreate(CUevent* event, unsigned int flags)
+{
+    if (!event)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (!stubCudaInitialised())
+        return CUDA_ERROR_NOT_INITIALIZED;
+    *event = new CUevent_st();
+    (*event)->flags = flags;
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventDestroy(CUevent event)
+{
+    if (!event)
+        return CUDA_ERROR_INVALID_HANDLE;
+    delete event;
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventRecord(CUevent event, CUstream stream)
+{
+    StubHeapScope heapScope;
+    if (!event || !stream)
+        return CUDA_ERROR_INVALID_HANDLE;
+    event->record = std::make_shared<CUevent_st::Record>();
+    event->marker = toCpuStream(stream)->enqueue([record = event->record]()
+    {
+        record->completedAt = std::chrono::steady_clock::now();
+        record->complete = true;
+    });
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventQuery(CUevent event)
+{
+    if (!event)
+        return CUDA_ERROR_INVALID_HANDLE;
+    if (event->record && !event->record->complete)
+        return CUDA_ERROR_NOT_READY;
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventSynchronize(CUevent event)
+{
+    if (!event)
+        return CUDA_ERROR_INVALID_HANDLE;
+    if (event->record && !event->record->complete)
+        event->marker.wait();
+    return CUDA_SUCCESS;
+}
+
+CUresult cuEventElapsedTime(float* milliseconds, CUevent start, CUevent end)
+{
+    if (!milliseconds)
+        return CUDA_ERROR_INVALID_VALUE;
+    if (!start || !end || !start->record || !end->record || (start->flags & CU_EVENT_DISABLE_TIMING) || (end->flags & CU_EVENT_DISABLE_TIMING))
+        return CUDA_ERROR_INVALID_HANDLE;
+    if (!start->record->complete || !end->record->complete)
+        return CUDA_ERROR_NOT_READY;
+    *milliseconds = std::chrono::duration<float, std::milli>(end->record->completedAt - start->record->completedAt).count();
+    return CUDA_SUCCESS;
+}
+
+CUresult cuStreamWaitEvent(CUstream stream, CUevent event, unsigned int /*flags*/)
+{
+    StubHeapScope heapScope;
+    if (!stream || !event)
+        return CUDA_ERROR_INVALID_HANDLE;
+    if (!event->record || event->record->complete)
+        return CUDA_SUCCESS;
+    toCpuStream(stream)->enqueue([marker = event->marker]() { marker.wait(); });
+    return CUDA_SUCCESS;
+}
+
+struct CUgraphicsResource_st
+{
+    ID3D11Resource* resource = nullptr; // Referenced while registered
+    bool mapped = false;
+};
+
+CUresult cuGraphicsD3D11RegisterResource(CUgraphicsResource* resource, struct ID3D11Resource* d3dResource, unsigned int /*flags*/)
+{
+    if (!resource || !d3dResource)
+        return CUDA_ERROR_INVALID_VALUE;
+    *resource = new CUgraphicsResource_st();
+    (*resource)->resource = d3dResource;
+    d3dResource->AddRef();
+    return CUDA_SUCCESS;
+}
+
+CUresult cuGraphicsUnregisterResource(CUgraphicsResource resource)
+{
+    if (!resource)
+        return CUDA_ERROR_INVALID_HANDLE;
+    resource->resource->Release();
+    delete resource;
+    return CUDA_SUCCESS;
+}
+
+CUresult cuGraphicsMapResources(unsigned int count, CUgraphicsResource* resources, CUstream /*stream*/)
+{
+    if (!resources)
+        return CUDA_ERROR_INVALID_VALUE;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (!resources[i])
+            return CUDA_ERROR_INVALID_HANDLE;
+        if (resources[i]->mapped)
+            return CUDA_ERROR_ALREADY_MAPPED;
+    }
+    ++stubCounters().mapCalls;
+    stubCounters().mappedResources += count;
+    for (unsigned int i = 0; i < count; ++i)
+        resources[i]->mapped = true;
+    return CUDA_SUCCESS;
+}
+
+CUresult cuGraphicsUnmapResources(unsigned int count, CUgraphicsResource* resources, CUstream stream)
+{
+    StubHeapScope heapScope;
+    if (!resources)
+        return CUDA_ERROR_INVALID_VALUE;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        if (!resources[i])
+            return CUDA_ERROR_INVALID_HANDLE;
+        if (!resources[i]->mapped)
+            return CUDA_ERROR_NOT_MAPPED;
+    }
+    ++stubCounters().unmapCalls;
+    // D3D waits for the work queued on the stream so far before it next uses the textures
+    const CpuStream::Marker marker = stream ? toCpuStream(stream)->mark() : CpuStream::Marker();
+    for (unsigned int i = 0; i < count; ++i)
+    {
+        resources[i]->mapped = false;
+        if (!stream)
+            continue;
+        ID3D11Resource* resource = resources[i]->resource;
+        std::function<void()> previous = std::move(resource->stubPending);
+        resource->stubPending = [previous, marker]()
+        {
+            if (previous)
+                previous();
+            marker.wait();
+        };
+    }
+    return CUDA_SUCCESS;
+}
+
+CUresult cuGraphicsSubResourceGetMappedArray(CUarray* array, CUgraphicsResource resource, unsigned int arrayIndex, unsigned int mipLevel)
+{
+    if (!array)
+        return CUDA_ERROR_INVALID_VALUE;
+    auto* texture = resource ? dynamic_cast<ID3D11Texture2D*>(resource->resource) : nullptr;
+    if (!texture || arrayIndex != 0 || mipLevel != 0)
+        return CUDA_ERROR_INVALID_HANDLE;
+    if (!resource->mapped)
+        return CUDA_ERROR_NOT_MAPPED;
+    *array = reinterpret_cast<CUarray>(texture->stubData.data());
+    return CUDA_SUCCESS;
+}
+
+CUresult cuGraphicsResourceGetMappedPointer(CUdeviceptr* pointer, size_t* size, CUgraphicsResource resource)
+{
+    if (!pointer || !size)
+        return CUDA_ERROR_INVALID_VALUE;
+    auto* buffer = resource ? dynamic_cast<ID3D11Buffer*>(resource->resource) : nullptr;
+    if (!buffer)
+        return CUDA_ERROR_INVALID_HANDLE;
+    if (!resource->mapped)
+        return CUDA_ERROR_NOT_MAPPED;
+    *pointer = reinterpret_cast<CUdeviceptr>(buffer->stubData.data());
+    *size = buffer->stubData.size();
+    return CUDA_SUCCESS;
+}
@@ -0,0 +1,795 @@
+// Win32 and D3D11 stand-ins, see win32/windows.h and win32/d3d11.h
+
+#include "win32/windows.h"
+#include "win32/shlwapi.h"
+#include "win32/tchar.h"
+#include "win32/d3d11.h"
+
+#include "Stubs.h"
+#include "StubPixels.h"
+#include "PixelConversion.h"
+#include "GuidedFilter.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+
+LONG RegOpenKeyEx(HKEY /*key*/, LPCTSTR /*subKey*/, DWORD /*options*/, DWORD /*desired*/, HKEY* result)
+{
+    *result = HKEY_CURRENT_USER;
+    return ERROR_SUCCESS;
+}
+
+LONG RegQueryValueEx(HKEY /*key*/, LPCTSTR /*valueName*/, DWORD* /*reserved*/, DWORD* /*type*/, LPBYTE data, DWORD* dataSize)
+{
+    // The app appends the DLL name in the space the value took, so the executable's name is at least as long
+    const char path[] = "loopback\\d3renderstream_loopback.exe";
+    if (*dataSize < sizeof(path))
+        return 234; // ERROR_MORE_DATA
+    std::memcpy(data, path, sizeof(path));
+    *dataSize = sizeof(path);
+    return ERROR_SUCCESS;
+}
+
+HMODULE LoadLibraryEx(LPCTSTR /*fileName*/, HANDLE /*file*/, DWORD /*flags*/)
+{
+    static int loopback;
+    return &loopback;
+}
+
+HMODULE LoadLibrary(LPCTSTR fileName)
+{
+    return LoadLibraryEx(fileName, nullptr, 0);
+}
+
+void* GetProcAddress(HMODULE /*module*/, const char* procName)
+{
+    return renderStreamStubProc(procName);
+}
+
+BOOL PathRemoveFileSpec(TCHAR* path)
+{
+    TCHAR* separator = std::strrchr(path, '\\');
+    if (!separator)
+        return 0;
+    *separator = 0;
+    return 1;
+}
+
+int _tcscat_s(TCHAR* dest, size_t size, const TCHAR* src)
+{
+    if (std::strlen(dest) + std::strlen(src) + 1 > size)
+        return 34; // ERANGE
+    std::strcat(dest, src);
+    return 0;
+}
+
+UINT stubFormatBytes(DXGI_FORMAT format)
+{
+    switch (format)
+    {
+    case DXGI_FORMAT_R32G32B32A32_FLOAT: return 16;
+    case DXGI_FORMAT_R32G32B32_FLOAT: return 12;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R16G16B16A16_UNORM:
+    case DXGI_FORMAT_R32G32_FLOAT: return 8;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8X8_UNORM:
+    case DXGI_FORMAT_R32_FLOAT:
+    case DXGI_FORMAT_D24_UNORM_S8_UINT: return 4;
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_R16_UNORM: return 2;
+    case DXGI_FORMAT_R8_UNORM:
+    case DXGI_FORMAT_A8_UNORM: return 1;
+    default: return 0;
+    }
+}
+
+namespace
+{
+    using Texel = std::array<float, 4>; // RGBA
+
+    // Reads (width) texels of a row into RGBA
+    void readRow(DXGI_FORMAT format, const uint8_t* row, uint32_t width, Texel* out)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            Texel& t = out[x];
+            switch (format)
+            {
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8X8_UNORM:
+                t = { row[x * 4 + 2] / 255.f, row[x * 4 + 1] / 255.f, row[x * 4 + 0] / 255.f, format == DXGI_FORMAT_B8G8R8X8_UNORM ? 1.f : row[x * 4 + 3] / 255.f };
+                break;
+            case DXGI_FORMAT_R8G8B8A8_UNORM:
+                t = { row[x * 4 + 0] / 255.f, row[x * 4 + 1] / 255.f, row[x * 4 + 2] / 255.f, row[x * 4 + 3] / 255.f };
+                break;
+            case DXGI_FORMAT_A8_UNORM:
+                t = { 0.f, 0.f, 0.f, row[x] / 255.f };
+                break;
+            case DXGI_FORMAT_R8_UNORM:
+                t = { row[x] / 255.f, 0.f, 0.f, 1.f };
+                break;
+            case DXGI_FORMAT_R16_UNORM:
+            {
+                uint16_t c;
+                std::memcpy(&c, row + x * 2, 2);
+                t = { c / 65535.f, 0.f, 0.f, 1.f };
+                break;
+            }
+            case DXGI_FORMAT_R16_FLOAT:
+            {
+                uint16_t c;
+                std::memcpy(&c, row + x * 2, 2);
+                t = { stubHalfToFloat(c), 0.f, 0.f, 1.f };
+                break;
+            }
+            case DXGI_FORMAT_R32_FLOAT:
+                t = { 0.f, 0.f, 0.f, 1.f };
+                std::memcpy(&t[0], row + x * 4, 4);
+                break;
+            case DXGI_FORMAT_R32G32_FLOAT:
+                t = { 0.f, 0.f, 0.f, 1.f };
+                std::memcpy(&t[0], row + x * 8, 8);
+                break;
+            case DXGI_FORMAT_R16G16B16A16_UNORM:
+            {
+                uint16_t c[4];
+                std::memcpy(c, row + x * 8, 8);
+                t = { c[0] / 65535.f, c[1] / 65535.f, c[2] / 65535.f, c[3] / 65535.f };
+                break;
+            }
+            case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            {
+                uint16_t c[4];
+                std::memcpy(c, row + x * 8, 8);
+                t = { stubHalfToFloat(c[0]), stubHalfToFloat(c[1]), stubHalfToFloat(c[2]), stubHalfToFloat(c[3]) };
+                break;
+            }
+            case DXGI_FORMAT_R32G32B32A32_FLOAT:
+                std::memcpy(t.data(), row + x * 16, 16);
+                break;
+            default:
+                t = { 0.f, 0.f, 0.f, 0.f };
+                break;
+            }
+        }
+    }
+
+    void writeRow(DXGI_FORMAT format, const Texel* in, uint32_t width, uint8_t* row)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const Texel& t = in[x];
+            switch (format)
+            {
+            case DXGI_FORMAT_B8G8R8A8_UNORM:
+            case DXGI_FORMAT_B8G8R8X8_UNORM:
+                row[x * 4 + 0] = uint8_t(stubFloatToUnorm(t[2], 255.f));
+                row[x * 4 + 1] = uint8_t(stubFloatToUnorm(t[1], 255.f));
+                row[x * 4 + 2] = uint8_t(stubFloatToUnorm(t[0], 255.f));
+                row[x * 4 + 3] = uint8_t(stubFloatToUnorm(t[3], 255.f));
+                break;
+            case DXGI_FORMAT_R8G8B8A8_UNORM:
+                for (int c = 0; c < 4; ++c)
+                    row[x * 4 + c] = uint8_t(stubFloatToUnorm(t[c], 255.f));
+                break;
+            case DXGI_FORMAT_A8_UNORM:
+                row[x] = uint8_t(stubFloatToUnorm(t[3], 255.f));
+                break;
+            case DXGI_FORMAT_R8_UNORM:
+                row[x] = uint8_t(stubFloatToUnorm(t[0], 255.f));
+                break;
+            case DXGI_FORMAT_R16_UNORM:
+            {
+                const uint16_t c = uint16_t(stubFloatToUnorm(t[0], 65535.f));
+                std::memcpy(row + x * 2, &c, 2);
+                break;
+            }
+            case DXGI_FORMAT_R16_FLOAT:
+            {
+                const uint16_t c = stubFloatToHalf(t[0]);
+                std::memcpy(row + x * 2, &c, 2);
+                break;
+            }
+            case DXGI_FORMAT_R32_FLOAT:
+                std::memcpy(row + x * 4, &t[0], 4);
+                break;
+            case DXGI_FORMAT_R32G32_FLOAT:
+                std::memcpy(row + x * 8, &t[0], 8);
+                break;
+            case DXGI_FORMAT_R16G16B16A16_UNORM:
+            {
+                uint16_t c[4];
+                for (int i = 0; i < 4; ++i)
+                    c[i] = uint16_t(stubFloatToUnorm(t[i], 65535.f));
+                std::memcpy(row + x * 8, c, 8);
+                break;
+            }
+            case DXGI_FORMAT_R16G16B16A16_FLOAT:
+            {
+                uint16_t c[4];
+                for (int i = 0; i < 4; ++i)
+                    c[i] = stubFloatToHalf(t[i]);
+                std::memcpy(row + x * 8, c, 8);
+                break;
+            }
+            case DXGI_FORMAT_R32G32B32A32_FLOAT:
+                std::memcpy(row + x * 16, t.data(), 16);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    const uint8_t* texelRow(const ID3D11Texture2D* texture, uint32_t y)
+    {
+        return texture->stubData.data() + size_t(y) * texture->stubPitch;
+    }
+
+    uint8_t* texelRow(ID3D11Texture2D* texture, uint32_t y)
+    {
+        return texture->stubData.data() + size_t(y) * texture->stubPitch;
+    }
+
+    ID3D11Texture2D* textureOf(ID3D11View* view)
+    {
+        if (!view)
+            return nullptr;
+        if (view->stubTexture)
+            view->stubTexture->stubSync();
+        return view->stubTexture;
+    }
+
+    ID3D11Buffer* bufferOf(ID3D11View* view)
+    {
+        if (!view)
+            return nullptr;
+        if (view->stubBuffer)
+            view->stubBuffer->stubSync();
+        return view->stubBuffer;
+    }
+
+    // Nearest texel sampling of a row of (texture), as the app's shaders see it when drawn at their own size
+    struct Sampler
+    {
+        explicit Sampler(const ID3D11Texture2D* texture, uint32_t targetWidth)
+            : texture(texture)
+            , row(texture ? texture->stubDesc.Width : 0)
+            , xs(targetWidth)
+        {
+            if (!texture)
+                return;
+            for (uint32_t x = 0; x < targetWidth; ++x)
+                xs[x] = std::min(uint32_t((x + 0.5) * texture->stubDesc.Width / targetWidth), texture->stubDesc.Width - 1);
+        }
+
+        // Samples target row (y) of (targetHeight) from the rows [top, top + height) of the texture
+        const Texel* sample(uint32_t y, uint32_t targetHeight, uint32_t top, uint32_t height, std::vector<Texel>& out)
+        {
+            out.resize(xs.size());
+            if (!texture)
+            {
+                std::fill(out.begin(), out.end(), Texel{ 0.f, 0.f, 0.f, 0.f });
+                return out.data();
+            }
+            const uint32_t ty = top + std::min(uint32_t((y + 0.5) * height / targetHeight), height - 1);
+            readRow(texture->stubDesc.Format, texelRow(texture, ty), texture->stubDesc.Width, row.data());
+            for (size_t x = 0; x < xs.size(); ++x)
+                out[x] = row[xs[x]];
+            return out.data();
+        }
+
+        const ID3D11Texture2D* texture;
+        std::vector<Texel> row;
+        std::vector<uint32_t> xs;
+    };
+
+    uint32_t constantU32(ID3D11Buffer* buffer, size_t offset)
+    {
+        uint32_t value = 0;
+        if (buffer && buffer->stubData.size() >= offset + sizeof(value))
+            std::memcpy(&value, buffer->stubData.data() + offset, sizeof(value));
+        return value;
+    }
+
+    float constantF32(ID3D11Buffer* buffer, size_t offset)
+    {
+        float value = 0.f;
+        if (buffer && buffer->stubData.size() >= offset + sizeof(value))
+            std::memcpy(&value, buffer->stubData.data() + offset, sizeof(value));
+        return value;
+    }
+
+    // The matte in the alpha channel, with the colour multiplied by it unless (straightAlpha)
+    Texel keyed(const Texel& colour, float matte, bool straightAlpha)
+    {
+        const float scale = straightAlpha ? 1.f : matte;
+        return { colour[0] * scale, colour[1] * scale, colour[2] * scale, colour[3] * matte };
+    }
+
+    // PixelShader.hlsl and OutputShader.hlsl: technique 0 writes the output, 1 the input keyed by the output's alpha,
+    // 2 the planar output and 3 the input keyed by the matte the output's guided filter coefficients refine, over the
+    // whole of (target)
+    void composite(uint32_t technique, bool straightAlpha, const ID3D11Texture2D* input, const ID3D11Texture2D* output, ID3D11Texture2D* target)
+    {
+        const uint32_t width = target->stubDesc.Width;
+        const uint32_t height = target->stubDesc.Height;
+
+        if (technique == 0 && output && output->stubDesc.Width == width && output->stubDesc.Height == height && output->stubDesc.Format == target->stubDesc.Format)
+        {
+            for (uint32_t y = 0; y < height; ++y)
+                std::memcpy(texelRow(target, y), texelRow(output, y), size_t(width) * stubFormatBytes(target->stubDesc.Format));
+            return;
+        }
+        if (technique == 2 && output && output->stubDesc.Format == DXGI_FORMAT_R32_FLOAT && output->stubDesc.Width == width && output->stubDesc.Height == height * 3 && target->stubDesc.Format == DXGI_FORMAT_B8G8R8A8_UNORM)
+        {
+            planarF32ToBgra8(reinterpret_cast<const float*>(output->stubData.data()), output->stubPitch, target->stubData.data(), target->stubPitch, width, height);
+            return;
+        }
+        if (technique == 3 && input && output && output->stubDesc.Format == DXGI_FORMAT_R32G32_FLOAT && input->stubDesc.Format == DXGI_FORMAT_B8G8R8A8_UNORM
+            && input->stubDesc.Width == width && input->stubDesc.Height == height && target->stubDesc.Format == DXGI_FORMAT_B8G8R8A8_UNORM)
+        {
+            std::vector<float> matte(size_t(width) * height);
+            guidedFilterUpsample(reinterpret_cast<const float*>(output->stubData.data()), output->stubPitch, output->stubDesc.Width, output->stubDesc.Height,
+                input->stubData.data(), input->stubPitch, matte.data(), width * sizeof(float), width, height);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                const uint8_t* in = texelRow(input, y);
+                uint8_t* out = texelRow(target, y);
+                for (uint32_t x = 0; x < width * 4; ++x)
+                {
+                    const bool alpha = x % 4 == 3;
+                    out[x] = uint8_t(stubFloatToUnorm(in[x] / 255.f * (straightAlpha && !alpha ? 1.f : matte[size_t(y) * width + x / 4]), 255.f));
+                }
+            }
+            return;
+        }
+
+        Sampler inputSampler(input, width), outputSampler(output, width);
+        std::vector<Texel> inputRow, outputRow, planes[3], result(width);
+        const uint32_t outputHeight = output ? output->stubDesc.Height : 1;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            switch (technique)
+            {
+            case 1:
+            {
+                const Texel* in = inputSampler.sample(y, height, 0, input ? input->stubDesc.Height : 1, inputRow);
+                const Texel* out = outputSampler.sample(y, height, 0, outputHeight, outputRow);
+                for (uint32_t x = 0; x < width; ++x)
+                    result[x] = keyed(in[x], out[x][3], straightAlpha);
+                break;
+            }
+            case 2:
+            {
+                const uint32_t planeHeight = std::max(outputHeight / 3, 1u);
+                const Texel* b = outputSampler.sample(y, height, 0, planeHeight, planes[0]);
+                const Texel* g = outputSampler.sample(y, height, planeHeight, planeHeight, planes[1]);
+                const Texel* r = outputSampler.sample(y, height, 2 * planeHeight, planeHeight, planes[2]);
+                for (uint32_t x = 0; x < width; ++x)
+                    result[x] = { r[x][0], g[x][0], b[x][0], 1.f };
+                break;
+            }
+            case 3:
+            {
+                const Texel* in = inputSampler.sample(y, height, 0, input ? input->stubDesc.Height : 1, inputRow);
+                const Texel* filter = outputSampler.sample(y, height, 0, outputHeight, outputRow);
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const float matte = std::clamp(filter[x][0] * guideLuma(in[x][0], in[x][1], in[x][2]) + filter[x][1], 0.f, 1.f);
+                    result[x] = keyed(in[x], matte, straightAlpha);
+                }
+                break;
+            }
+            default:
+                std::copy_n(outputSampler.sample(y, height, 0, outputHeight, outputRow), width, result.begin());
+                break;
+            }
+            writeRow(target->stubDesc.Format, result.data(), width, texelRow(target, y));
+        }
+    }
+
+    void drawPixelShader(ID3D11DeviceContext& context, ID3D11Texture2D* target)
+    {
+        composite(constantU32(context.stubPixelConstants[0], 0), constantU32(context.stubPixelConstants[0], 4) != 0, textureOf(context.stubPixelResources[0]), textureOf(context.stubPixelResources[1]), target);
+    }
+
+    void dispatchOutputShader(ID3D11DeviceContext& context)
+    {
+        if (ID3D11Texture2D* target = textureOf(context.stubComputeUavs[0]))
+            composite(constantU32(context.stubComputeConstants[0], 0), constantU32(context.stubComputeConstants[0], 4) != 0, textureOf(context.stubComputeResources[0]), textureOf(context.stubComputeResources[1]), target);
+    }
+
+    // MatteShader.hlsl: the coefficients of the guided filter that refines a matte against the input, at the size of
+    // the matte, see GuidedFilter.h
+    void dispatchMatteShader(ID3D11DeviceContext& context)
+    {
+        ID3D11Buffer* constants = context.stubComputeConstants[0];
+        const uint32_t radius = std::min(constantU32(constants, 0), 4u); // MAX_RADIUS
+        const float epsilon = constantF32(constants, 4);
+        const ID3D11Texture2D* input = textureOf(context.stubComputeResources[0]);
+        const ID3D11Texture2D* matte = textureOf(context.stubComputeResources[1]);
+        ID3D11Texture2D* target = textureOf(context.stubComputeUavs[0]);
+        if (!input || !matte || !target || target->stubDesc.Format != DXGI_FORMAT_R32G32_FLOAT)
+            return;
+
+        const uint32_t width = target->stubDesc.Width;
+        const uint32_t height = target->stubDesc.Height;
+        std::vector<float> guide(size_t(width) * height);
+        std::vector<uint8_t> alpha(size_t(width) * height);
+        Sampler inputSampler(input, width), matteSampler(matte, width);
+        std::vector<Texel> row;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const Texel* colours = inputSampler.sample(y, height, 0, input->stubDesc.Height, row);
+            for (uint32_t x = 0; x < width; ++x)
+                guide[size_t(y) * width + x] = guideLuma(colours[x][0], colours[x][1], colours[x][2]);
+            const Texel* mattes = matteSampler.sample(y, height, 0, matte->stubDesc.Height, row);
+            for (uint32_t x = 0; x < width; ++x)
+                alpha[size_t(y) * width + x] = uint8_t(stubFloatToUnorm(mattes[x][3], 255.f));
+        }
+        guidedFilterCoefficients(guide.data(), width * sizeof(float), alpha.data(), width, reinterpret_cast<float*>(target->stubData.data()), target->stubPitch,
+            width, height, radius, epsilon);
+    }
+
+    // InputShader.hlsl: colour input to an effect's input layout in a raw buffer, scaled to the effect size. Planar
+    // layouts are B, G and R float planes one above the other, chunky ones (components) 8 bit components per pixel.
+    void dispatchInputShader(ID3D11DeviceContext& context)
+    {
+        ID3D11Buffer* constants = context.stubComputeConstants[0];
+        const uint32_t width = constantU32(constants, 0);
+        const uint32_t height = constantU32(constants, 4);
+        const uint32_t pitch = constantU32(constants, 8);
+        const uint32_t offset = constantU32(constants, 12);
+        const bool planar = constantU32(constants, 16) != 0;
+        const uint32_t components = planar ? 3 : constantU32(constants, 20);
+        const bool redFirst = constantU32(constants, 24) != 0;
+        const ID3D11Texture2D* input = textureOf(context.stubComputeResources[0]);
+        ID3D11Buffer* output = bufferOf(context.stubComputeUavs[0]);
+        if (!input || !output || components < 3 || components > 4)
+            return;
+        if (uint64_t(offset) + uint64_t(pitch) * height * (planar ? 3 : 1) > output->stubData.size())
+            return;
+        uint8_t* image = output->stubData.data() + offset;
+        const bool bgra8 = input->stubDesc.Width == width && input->stubDesc.Height == height && input->stubDesc.Format == DXGI_FORMAT_B8G8R8A8_UNORM;
+        if (planar && bgra8)
+        {
+            bgra8ToPlanarF32(input->stubData.data(), input->stubPitch, reinterpret_cast<float*>(image), pitch, width, height);
+            return;
+        }
+        if (bgra8)
+        {
+            const int order[4] = { redFirst ? 2 : 0, 1, redFirst ? 0 : 2, 3 }; // BGRA texel bytes in output order
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                const uint8_t* in = texelRow(input, y);
+                uint8_t* out = image + size_t(y) * pitch;
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    for (uint32_t c = 0; c < components; ++c)
+                        out[x * components + c] = in[x * 4 + order[c]];
+                }
+            }
+            return;
+        }
+
+        Sampler sampler(input, width);
+        std::vector<Texel> row;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            const Texel* texels = sampler.sample(y, height, 0, input->stubDesc.Height, row);
+            if (planar)
+            {
+                for (uint32_t plane = 0; plane < 3; ++plane)
+                {
+                    float* out = reinterpret_cast<float*>(image + (size_t(plane) * height + y) * pitch);
+                    for (uint32_t x = 0; x < width; ++x)
+                        out[x] = texels[x][2 - plane];
+                }
+                continue;
+            }
+            uint8_t* out = image + size_t(y) * pitch;
+            for (uint32_t x = 0; x < width; ++x)
+            {
+                const Texel& t = texels[x];
+                const float ordered[4] = { redFirst ? t[0] : t[2], t[1], redFirst ? t[2] : t[0], t[3] };
+                for (uint32_t c = 0; c < components; ++c)
+                    out[x * components + c] = uint8_t(stubFloatToUnorm(ordered[c], 255.f));
+            }
+        }
+    }
+
+    template <typename T>
+    void bind(T*& slot, T* object)
+    {
+        if (object)
+            object->AddRef();
+        if (slot)
+            slot->Release();
+        slot = object;
+    }
+
+    template <typename T>
+    void bindAll(T** slots, UINT startSlot, UINT count, T* const* objects)
+    {
+        for (UINT i = 0; i < count && startSlot + i < ID3D11DeviceContext::STUB_SLOTS; ++i)
+            bind(slots[startSlot + i], objects ? objects[i] : nullptr);
+    }
+
+    template <typename View>
+    HRESULT createView(ID3D11Resource* resource, View** view)
+    {
+        auto* texture = dynamic_cast<ID3D11Texture2D*>(resource);
+        auto* buffer = dynamic_cast<ID3D11Buffer*>(resource);
+        if ((!texture && !buffer) || !view)
+            return E_INVALIDARG;
+        *view = new View();
+        resource->AddRef();
+        (*view)->stubTexture = texture;
+        (*view)->stubBuffer = buffer;
+        return S_OK;
+    }
+
+    template <typename Shader>
+    HRESULT createShader(const void* bytecode, size_t bytecodeLength, Shader** shader)
+    {
+        if (!bytecode || !shader)
+            return E_INVALIDARG;
+        *shader = new Shader();
+        (*shader)->stubName.assign(static_cast<const char*>(bytecode), strnlen(static_cast<const char*>(bytecode), bytecodeLength));
+        return S_OK;
+    }
+}
+
+ID3D11DeviceContext::~ID3D11DeviceContext()
+{
+    bind(stubRenderTarget, static_cast<ID3D11RenderTargetView*>(nullptr));
+    bind(stubPixelShader, static_cast<ID3D11PixelShader*>(nullptr));
+    bind(stubComputeShader, static_cast<ID3D11ComputeShader*>(nullptr));
+    bindAll(stubPixelConstants, 0, STUB_SLOTS, static_cast<ID3D11Buffer* const*>(nullptr));
+    bindAll(stubComputeConstants, 0, STUB_SLOTS, static_cast<ID3D11Buffer* const*>(nullptr));
+    bindAll(stubPixelResources, 0, STUB_SLOTS, static_cast<ID3D11ShaderResourceView* const*>(nullptr));
+    bindAll(stubComputeResources, 0, STUB_SLOTS, static_cast<ID3D11ShaderResourceView* const*>(nullptr));
+    bindAll(stubComputeUavs, 0, STUB_SLOTS, static_cast<ID3D11UnorderedAccessView* const*>(nullptr));
+}
+
+void ID3D11DeviceContext::OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* /*depthStencilView*/)
+{
+    bind(stubRenderTarget, numViews > 0 ? renderTargetViews[0] : nullptr);
+}
+
+void ID3D11DeviceContext::ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const FLOAT colour[4])
+{
+    StubHeapScope heapScope;
+    ID3D11Texture2D* texture = textureOf(renderTargetView);
+    if (!texture)
+        return;
+    std::vector<Texel> row(texture->stubDesc.Width, Texel{ colour[0], colour[1], colour[2], colour[3] });
+    for (uint32_t y = 0; y < texture->stubDesc.Height; ++y)
+        writeRow(texture->stubDesc.Format, row.data(), texture->stubDesc.Width, texelRow(texture, y));
+}
+
+void ID3D11DeviceContext::ClearDepthStencilView(ID3D11DepthStencilView* /*depthStencilView*/, UINT /*clearFlags*/, FLOAT /*depth*/, BYTE /*stencil*/)
+{
+    // Nothing is depth tested
+}
+
+void ID3D11DeviceContext::RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports)
+{
+    if (numViewports > 0)
+        stubViewport = viewports[0];
+}
+
+void ID3D11DeviceContext::UpdateSubresource(ID3D11Resource* resource, UINT /*subresource*/, const D3D11_BOX* /*box*/, const void* data, UINT /*rowPitch*/, UINT /*depthPitch*/)
+{
+    if (auto* buffer = dynamic_cast<ID3D11Buffer*>(resource))
+        std::memcpy(buffer->stubData.data(), data, buffer->stubData.size());
+}
+
+// Resources copied are the same size and format, as D3D requires
+void ID3D11DeviceContext::CopyResource(ID3D11Resource* destination, ID3D11Resource* source)
+{
+    destination->stubSync();
+    source->stubSync();
+    if (auto* to = dynamic_cast<ID3D11Texture2D*>(destination))
+    {
+        if (auto* from = dynamic_cast<ID3D11Texture2D*>(source))
+            std::copy(from->stubData.begin(), from->stubData.end(), to->stubData.begin());
+    }
+    else if (auto* to = dynamic_cast<ID3D11Buffer*>(destination))
+    {
+        if (auto* from = dynamic_cast<ID3D11Buffer*>(source))
+            std::copy(from->stubData.begin(), from->stubData.end(), to->stubData.begin());
+    }
+}
+
+void ID3D11DeviceContext::IASetVertexBuffers(UINT, UINT, ID3D11Buffer* const*, const UINT*, const UINT*)
+{
+    // Every draw is a fullscreen quad
+}
+
+void ID3D11DeviceContext::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY)
+{
+}
+
+void ID3D11DeviceContext::IASetInputLayout(ID3D11InputLayout*)
+{
+}
+
+void ID3D11DeviceContext::VSSetShader(ID3D11VertexShader*, void* const*, UINT)
+{
+}
+
+void ID3D11DeviceContext::PSSetShader(ID3D11PixelShader* shader, void* const*, UINT)
+{
+    bind(stubPixelShader, shader);
+}
+
+void ID3D11DeviceContext::PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* constantBuffers)
+{
+    bindAll(stubPixelConstants, startSlot, numBuffers, constantBuffers);
+}
+
+void ID3D11DeviceContext::PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* shaderResourceViews)
+{
+    bindAll(stubPixelResources, startSlot, numViews, shaderResourceViews);
+}
+
+void ID3D11DeviceContext::CSSetShader(ID3D11ComputeShader* shader, void* const*, UINT)
+{
+    bind(stubComputeShader, shader);
+}
+
+void ID3D11DeviceContext::CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* constantBuffers)
+{
+    bindAll(stubComputeConstants, startSlot, numBuffers, constantBuffers);
+}
+
+void ID3D11DeviceContext::CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* shaderResourceViews)
+{
+    bindAll(stubComputeResources, startSlot, numViews, shaderResourceViews);
+}
+
+void ID3D11DeviceContext::CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* unorderedAccessViews, const UINT* /*initialCounts*/)
+{
+    bindAll(stubComputeUavs, startSlot, numViews, unorderedAccessViews);
+}
+
+void ID3D11DeviceContext::Draw(UINT /*vertexCount*/, UINT /*startVertexLocation*/)
+{
+    StubHeapScope heapScope;
+    ++stubCounters().draws;
+    ID3D11Texture2D* target = textureOf(stubRenderTarget);
+    if (!target || !stubPixelShader)
+        return;
+    if (stubPixelShader->stubName == "PixelShader")
+        drawPixelShader(*this, target);
+    else
+        std::fprintf(stderr, "D3D11 stand-in: no CPU version of pixel shader %s\n", stubPixelShader->stubName.c_str());
+}
+
+void ID3D11DeviceContext::Dispatch(UINT /*threadGroupCountX*/, UINT /*threadGroupCountY*/, UINT /*threadGroupCountZ*/)
+{
+    StubHeapScope heapScope;
+    ++stubCounters().dispatches;
+    if (!stubComputeShader)
+        return;
+    if (stubComputeShader->stubName == "InputShader")
+        dispatchInputShader(*this);
+    else if (stubComputeShader->stubName == "MatteShader")
+        dispatchMatteShader(*this);
+    else if (stubComputeShader->stubName == "OutputShader" || stubComputeShader->stubName == "OutputShaderFloat")
+        dispatchOutputShader(*this);
+    else
+        std::fprintf(stderr, "D3D11 stand-in: no CPU version of compute shader %s\n", stubComputeShader->stubName.c_str());
+}
+
+HRESULT ID3D11Device::CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture)
+{
+    StubHeapScope heapScope;
+    const UINT texelBytes = desc ? stubFormatBytes(desc->Format) : 0;
+    if (!texelBytes || !texture || desc->Width == 0 || desc->Height == 0)
+        return E_INVALIDARG;
+    auto* created = new ID3D11Texture2D();
+    created->stubDesc = *desc;
+    created->stubPitch = desc->Width * texelBytes;
+    created->stubData.resize(size_t(created->stubPitch) * desc->Height);
+    if (initialData && initialData->pSysMem)
+    {
+        for (UINT y = 0; y < desc->Height; ++y)
+            std::memcpy(texelRow(created, y), static_cast<const uint8_t*>(initialData->pSysMem) + size_t(y) * initialData->SysMemPitch, created->stubPitch);
+    }
+    ++stubCounters().texturesCreated;
+    stubCounters().textureBytes += created->stubData.size();
+    *texture = created;
+    return S_OK;
+}
+
+HRESULT ID3D11Device::CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer)
+{
+    StubHeapScope heapScope;
+    if (!desc || !buffer)
+        return E_INVALIDARG;
+    auto* created = new ID3D11Buffer();
+    created->stubData.resize(desc->ByteWidth);
+    if (initialData && initialData->pSysMem)
+        std::memcpy(created->stubData.data(), initialData->pSysMem, desc->ByteWidth);
+    *buffer = created;
+    return S_OK;
+}
+
+HRESULT ID3D11Device::CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* /*desc*/, ID3D11ShaderResourceView** view)
+{
+    StubHeapScope heapScope;
+    return createView(resource, view);
+}
+
+HRESULT ID3D11Device::CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* /*desc*/, ID3D11RenderTargetView** view)
+{
+    StubHeapScope heapScope;
+    return createView(resource, view);
+}
+
+HRESULT ID3D11Device::CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* /*desc*/, ID3D11DepthStencilView** view)
+{
+    StubHeapScope heapScope;
+    return createView(resource, view);
+}
+
+HRESULT ID3D11Device::CreateUnorderedAccessView(ID3D11Resource* resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* /*desc*/, ID3D11UnorderedAccessView** view)
+{
+    StubHeapScope heapScope;
+    return createView(resource, view);
+}
+
+// Every format the stand-in supports can be written through an unordered access view
+HRESULT ID3D11Device::CheckFormatSupport(DXGI_FORMAT format, UINT* formatSupport)
+{
+    if (!formatSupport || !stubFormatBytes(format))
+        return E_FAIL;
+    *formatSupport = D3D11_FORMAT_SUPPORT_TYPED_UNORDERED_ACCESS_VIEW;
+    return S_OK;
+}
+
+HRESULT ID3D11Device::CreateVertexShader(const void* bytecode, size_t bytecodeLength, ID3D11ClassLinkage* /*classLinkage*/, ID3D11VertexShader** shader)
+{
+    StubHeapScope heapScope;
+    return createShader(bytecode, bytecodeLength, shader);
+}
+
+HRESULT ID3D11Device::CreatePixelShader(const void* bytecode, size_t bytecodeLength, ID3D11ClassLinkage* /*classLinkage*/, ID3D11PixelShader** shader)
+{
+    StubHeapScope heapScope;
+    return createShader(bytecode, bytecodeLength, shader);
+}
+
+HRESULT ID3D11Device::CreateComputeShader(const void* bytecode, size_t bytecodeLength, ID3D11ClassLinkage* /*classLinkage*/, ID3D11ComputeShader** shader)
+{
+    StubHeapScope heapScope;
+    return createShader(bytecode, bytecodeLength, shader);
+}
+
+HRESULT ID3D11Device::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* /*elements*/, UINT /*numElements*/, const void* /*bytecode*/, size_t /*bytecodeLength*/, ID3D11InputLayout** inputLayout)
+{
+    StubHeapScope heapScope;
+    if (!inputLayout)
+        return E_INVALIDARG;
+    *inputLayout = new ID3D11InputLayout();
+    return S_OK;
+}
+
+HRESULT D3D11CreateDevice(IDXGIAdapter* /*adapter*/, D3D_DRIVER_TYPE /*driverType*/, HMODULE /*software*/, UINT /*flags*/, const D3D_FEATURE_LEVEL* /*featureLevels*/, UINT /*numFeatureLevels*/,
+    UINT /*sdkVersion*/, ID3D11Device** device, D3D_FEATURE_LEVEL* featureLevel, ID3D11DeviceContext** immediateContext)
+{
+    StubHeapScope heapScope;
+    if (device)
+        *device = new ID3D11Device();
+    if (immediateContext)
+        *immediateContext = new ID3D11DeviceContext();
+    if (featureLevel)
+        *featureLevel = D3D_FEATURE_LEVEL_11_0;
+    return S_OK;
+}
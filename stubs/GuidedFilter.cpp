@@ -0,0 +1,336 @@
+#include "GuidedFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX2__)
+#define GUIDED_FILTER_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GUIDED_FILTER_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define GUIDED_FILTER_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    template <typename T>
+    T* row(T* base, size_t pitch, size_t y)
+    {
+        return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(base) + y * pitch);
+    }
+
+    // A plane of (width) x (height) floats
+    struct Plane
+    {
+        Plane(uint32_t width, uint32_t height)
+            : width(width)
+            , values(size_t(width) * height)
+        {
+        }
+
+        float* row(uint32_t y)
+        {
+            return values.data() + size_t(y) * width;
+        }
+
+        const float* row(uint32_t y) const
+        {
+            return values.data() + size_t(y) * width;
+        }
+
+        uint32_t width;
+        std::vector<float> values;
+    };
+
+    // Adds (width) floats of (src) to (dst) from (x) onwards, returns how far it got
+    size_t addRowSimd(const float* src, float* dst, size_t x, size_t width)
+    {
+#if defined(GUIDED_FILTER_AVX2)
+        for (; x + 8 <= width; x += 8)
+            _mm256_storeu_ps(dst + x, _mm256_add_ps(_mm256_loadu_ps(dst + x), _mm256_loadu_ps(src + x)));
+#elif defined(GUIDED_FILTER_SSE2)
+        for (; x + 4 <= width; x += 4)
+            _mm_storeu_ps(dst + x, _mm_add_ps(_mm_loadu_ps(dst + x), _mm_loadu_ps(src + x)));
+#elif defined(GUIDED_FILTER_NEON)
+        for (; x + 4 <= width; x += 4)
+            vst1q_f32(dst + x, vaddq_f32(vld1q_f32(dst + x), vld1q_f32(src + x)));
+#endif
+        return x;
+    }
+
+    // Sums (src) over the window of (radius) either side of each of (x) onwards, up to (end), which must be no more
+    // than (radius) from the end of the row; (x) must be at least (radius) from its start. Returns how far it got.
+    // Sums in the same order as windowSum.
+    size_t windowSumSimd(const float* src, float* dst, size_t x, size_t end, size_t radius)
+    {
+#if defined(GUIDED_FILTER_AVX2)
+        for (; x + 8 <= end; x += 8)
+        {
+            __m256 sum = _mm256_loadu_ps(src + x - radius);
+            for (size_t i = x - radius + 1; i <= x + radius; ++i)
+                sum = _mm256_add_ps(sum, _mm256_loadu_ps(src + i));
+            _mm256_storeu_ps(dst + x, sum);
+        }
+#elif defined(GUIDED_FILTER_SSE2)
+        for (; x + 4 <= end; x += 4)
+        {
+            __m128 sum = _mm_loadu_ps(src + x - radius);
+            for (size_t i = x - radius + 1; i <= x + radius; ++i)
+                sum = _mm_add_ps(sum, _mm_loadu_ps(src + i));
+            _mm_storeu_ps(dst + x, sum);
+        }
+#elif defined(GUIDED_FILTER_NEON)
+        for (; x + 4 <= end; x += 4)
+        {
+            float32x4_t sum = vld1q_f32(src + x - radius);
+            for (size_t i = x - radius + 1; i <= x + radius; ++i)
+                sum = vaddq_f32(sum, vld1q_f32(src + i));
+            vst1q_f32(dst + x, sum);
+        }
+#endif
+        return x;
+    }
+
+    // Sums (src) over the window of (radius) either side of (x), clipped to the (width) of the row
+    float windowSum(const float* src, size_t x, size_t width, size_t radius)
+    {
+        const size_t last = std::min(x + radius, width - 1);
+        size_t i = x > radius ? x - radius : 0;
+        float sum = src[i];
+        while (++i <= last)
+            sum += src[i];
+        return sum;
+    }
+
+    // a and b from the sums of the guide I, matte p, I * I and I * p over windows of (count) pixels, from (x) onwards.
+    // Returns how far it got.
+    size_t coefficientsSimd(const float* sumI, const float* sumP, const float* sumII, const float* sumIP, const float* count, float epsilon, float* a, float* b, size_t x, size_t width)
+    {
+#if defined(GUIDED_FILTER_AVX2)
+        const __m256 e = _mm256_set1_ps(epsilon);
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m256 n = _mm256_loadu_ps(count + x);
+            const __m256 meanI = _mm256_div_ps(_mm256_loadu_ps(sumI + x), n);
+            const __m256 meanP = _mm256_div_ps(_mm256_loadu_ps(sumP + x), n);
+            const __m256 variance = _mm256_sub_ps(_mm256_div_ps(_mm256_loadu_ps(sumII + x), n), _mm256_mul_ps(meanI, meanI));
+            const __m256 covariance = _mm256_sub_ps(_mm256_div_ps(_mm256_loadu_ps(sumIP + x), n), _mm256_mul_ps(meanI, meanP));
+            const __m256 ax = _mm256_div_ps(covariance, _mm256_add_ps(variance, e));
+            _mm256_storeu_ps(a + x, ax);
+            _mm256_storeu_ps(b + x, _mm256_sub_ps(meanP, _mm256_mul_ps(ax, meanI)));
+        }
+#elif defined(GUIDED_FILTER_SSE2)
+        const __m128 e = _mm_set1_ps(epsilon);
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128 n = _mm_loadu_ps(count + x);
+            const __m128 meanI = _mm_div_ps(_mm_loadu_ps(sumI + x), n);
+            const __m128 meanP = _mm_div_ps(_mm_loadu_ps(sumP + x), n);
+            const __m128 variance = _mm_sub_ps(_mm_div_ps(_mm_loadu_ps(sumII + x), n), _mm_mul_ps(meanI, meanI));
+            const __m128 covariance = _mm_sub_ps(_mm_div_ps(_mm_loadu_ps(sumIP + x), n), _mm_mul_ps(meanI, meanP));
+            const __m128 ax = _mm_div_ps(covariance, _mm_add_ps(variance, e));
+            _mm_storeu_ps(a + x, ax);
+            _mm_storeu_ps(b + x, _mm_sub_ps(meanP, _mm_mul_ps(ax, meanI)));
+        }
+#elif defined(GUIDED_FILTER_NEON)
+        const float32x4_t e = vdupq_n_f32(epsilon);
+        for (; x + 4 <= width; x += 4)
+        {
+            const float32x4_t n = vld1q_f32(count + x);
+            const float32x4_t meanI = vdivq_f32(vld1q_f32(sumI + x), n);
+            const float32x4_t meanP = vdivq_f32(vld1q_f32(sumP + x), n);
+            const float32x4_t variance = vsubq_f32(vdivq_f32(vld1q_f32(sumII + x), n), vmulq_f32(meanI, meanI));
+            const float32x4_t covariance = vsubq_f32(vdivq_f32(vld1q_f32(sumIP + x), n), vmulq_f32(meanI, meanP));
+            const float32x4_t ax = vdivq_f32(covariance, vaddq_f32(variance, e));
+            vst1q_f32(a + x, ax);
+            vst1q_f32(b + x, vsubq_f32(meanP, vmulq_f32(ax, meanI)));
+        }
+#endif
+        return x;
+    }
+
+    // (dst) = (top) + ((bottom) - (top)) * (weight), for (count) floats from (x) onwards. Returns how far it got.
+    size_t lerpRowSimd(const float* top, const float* bottom, float weight, float* dst, size_t x, size_t count)
+    {
+#if defined(GUIDED_FILTER_AVX2)
+        const __m256 w = _mm256_set1_ps(weight);
+        for (; x + 8 <= count; x += 8)
+        {
+            const __m256 t = _mm256_loadu_ps(top + x);
+            _mm256_storeu_ps(dst + x, _mm256_add_ps(t, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(bottom + x), t), w)));
+        }
+#elif defined(GUIDED_FILTER_SSE2)
+        const __m128 w = _mm_set1_ps(weight);
+        for (; x + 4 <= count; x += 4)
+        {
+            const __m128 t = _mm_loadu_ps(top + x);
+            _mm_storeu_ps(dst + x, _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(bottom + x), t), w)));
+        }
+#elif defined(GUIDED_FILTER_NEON)
+        const float32x4_t w = vdupq_n_f32(weight);
+        for (; x + 4 <= count; x += 4)
+        {
+            const float32x4_t t = vld1q_f32(top + x);
+            vst1q_f32(dst + x, vaddq_f32(t, vmulq_f32(vsubq_f32(vld1q_f32(bottom + x), t), w)));
+        }
+#endif
+        return x;
+    }
+
+    // Sums (src) over every pixel's window into (dst): down the columns of the window's rows, then along the row
+    void boxSum(const Plane& src, Plane& dst, uint32_t height, uint32_t radius, std::vector<float>& columns)
+    {
+        const size_t width = src.width;
+        const size_t interiorEnd = width > radius ? width - radius : 0;
+        for (uint32_t y = 0; y < height; ++y)
+        {
+            std::fill(columns.begin(), columns.end(), 0.f);
+            const uint32_t last = std::min(y + radius, height - 1);
+            for (uint32_t i = y > radius ? y - radius : 0; i <= last; ++i)
+            {
+                const float* in = src.row(i);
+                for (size_t x = addRowSimd(in, columns.data(), 0, width); x < width; ++x)
+                    columns[x] += in[x];
+            }
+
+            float* out = dst.row(y);
+            size_t x = 0;
+            for (; x < std::min<size_t>(radius, width); ++x)
+                out[x] = windowSum(columns.data(), x, width, radius);
+            if (x < interiorEnd)
+                x = windowSumSimd(columns.data(), out, x, interiorEnd, radius);
+            for (; x < width; ++x)
+                out[x] = windowSum(columns.data(), x, width, radius);
+        }
+    }
+
+    // Pixels in the window of each of (size) positions, clipped to the image
+    std::vector<float> windowCounts(uint32_t size, uint32_t radius)
+    {
+        std::vector<float> counts(size);
+        for (uint32_t i = 0; i < size; ++i)
+            counts[i] = float(std::min(i + radius, size - 1) - (i > radius ? i - radius : 0) + 1);
+        return counts;
+    }
+}
+
+void guidedFilterCoefficients(const float* guide, size_t guidePitch, const uint8_t* matte, size_t mattePitch, float* coefficients, size_t coefficientsPitch,
+    uint32_t width, uint32_t height, uint32_t radius, float epsilon)
+{
+    if (width == 0 || height == 0)
+        return;
+
+    // The guide I, matte p, I * I and I * p, summed over every window
+    Plane values[4] = { { width, height }, { width, height }, { width, height }, { width, height } };
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const float* g = row(guide, guidePitch, y);
+        const uint8_t* m = row(matte, mattePitch, y);
+        float* i = values[0].row(y);
+        float* p = values[1].row(y);
+        float* ii = values[2].row(y);
+        float* ip = values[3].row(y);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            i[x] = g[x];
+            p[x] = float(m[x]) / 255.f;
+            ii[x] = g[x] * g[x];
+            ip[x] = g[x] * p[x];
+        }
+    }
+    Plane sums[4] = { { width, height }, { width, height }, { width, height }, { width, height } };
+    std::vector<float> columns(width);
+    for (int i = 0; i < 4; ++i)
+        boxSum(values[i], sums[i], height, radius, columns);
+
+    // a and b of every pixel, then summed over every window, reusing the planes of I and p
+    const std::vector<float> columnCounts = windowCounts(width, radius);
+    const std::vector<float> rowCounts = windowCounts(height, radius);
+    std::vector<float> counts(width);
+    Plane& a = values[0];
+    Plane& b = values[1];
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+            counts[x] = columnCounts[x] * rowCounts[y];
+        const float* sumI = sums[0].row(y);
+        const float* sumP = sums[1].row(y);
+        const float* sumII = sums[2].row(y);
+        const float* sumIP = sums[3].row(y);
+        float* ay = a.row(y);
+        float* by = b.row(y);
+        for (size_t x = coefficientsSimd(sumI, sumP, sumII, sumIP, counts.data(), epsilon, ay, by, 0, width); x < width; ++x)
+        {
+            const float meanI = sumI[x] / counts[x];
+            const float meanP = sumP[x] / counts[x];
+            const float variance = sumII[x] / counts[x] - meanI * meanI;
+            const float covariance = sumIP[x] / counts[x] - meanI * meanP;
+            ay[x] = covariance / (variance + epsilon);
+            by[x] = meanP - ay[x] * meanI;
+        }
+    }
+    boxSum(a, sums[0], height, radius, columns);
+    boxSum(b, sums[1], height, radius, columns);
+
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const float* sumA = sums[0].row(y);
+        const float* sumB = sums[1].row(y);
+        float* out = row(coefficients, coefficientsPitch, y);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const float count = columnCounts[x] * rowCounts[y];
+            out[x * 2 + 0] = sumA[x] / count;
+            out[x * 2 + 1] = sumB[x] / count;
+        }
+    }
+}
+
+void guidedFilterUpsample(const float* coefficients, size_t coefficientsPitch, uint32_t width, uint32_t height, const uint8_t* input, size_t inputPitch,
+    float* matte, size_t mattePitch, uint32_t inputWidth, uint32_t inputHeight)
+{
+    if (width == 0 || height == 0)
+        return;
+
+    // Bilinear sampling at pixel centres, clamped to the edges, as the shaders' default sampler does
+    const auto sampleAt = [](uint32_t i, uint32_t size, uint32_t from, uint32_t& first, uint32_t& second) -> float
+    {
+        const float position = (float(i) + 0.5f) * float(from) / float(size) - 0.5f;
+        const float floor = std::floor(position);
+        const int64_t lower = int64_t(floor);
+        first = uint32_t(std::clamp<int64_t>(lower, 0, from - 1));
+        second = uint32_t(std::clamp<int64_t>(lower + 1, 0, from - 1));
+        return position - floor;
+    };
+    std::vector<uint32_t> lefts(inputWidth), rights(inputWidth);
+    std::vector<float> weights(inputWidth);
+    for (uint32_t x = 0; x < inputWidth; ++x)
+        weights[x] = sampleAt(x, inputWidth, width, lefts[x], rights[x]);
+
+    std::vector<float> blended(size_t(width) * 2); // a and b of a row of coefficients, between the two rows sampled
+    for (uint32_t y = 0; y < inputHeight; ++y)
+    {
+        uint32_t topRow, bottomRow;
+        const float weight = sampleAt(y, inputHeight, height, topRow, bottomRow);
+        const float* top = row(coefficients, coefficientsPitch, topRow);
+        const float* bottom = row(coefficients, coefficientsPitch, bottomRow);
+        for (size_t i = lerpRowSimd(top, bottom, weight, blended.data(), 0, blended.size()); i < blended.size(); ++i)
+            blended[i] = top[i] + (bottom[i] - top[i]) * weight;
+
+        const uint8_t* in = row(input, inputPitch, y);
+        float* out = row(matte, mattePitch, y);
+        for (uint32_t x = 0; x < inputWidth; ++x)
+        {
+            const float* left = &blended[lefts[x] * 2];
+            const float* right = &blended[rights[x] * 2];
+            const float a = left[0] + (right[0] - left[0]) * weights[x];
+            const float b = left[1] + (right[1] - left[1]) * weights[x];
+            const float refined = a * guideLuma(in[x * 4 + 2] / 255.f, in[x * 4 + 1] / 255.f, in[x * 4 + 0] / 255.f) + b;
+            out[x] = refined > 0.f ? (refined < 1.f ? refined : 1.f) : 0.f; // NaN fails both comparisons
+        }
+    }
+}
@@ -0,0 +1,31 @@
+// CPU reference of the guided filter (He, Sun and Tang) MatteShader.hlsl and technique 3 of the output and pixel
+// shaders refine a matte with, when an effect produces it at a fraction of the size of its input, so the filter can
+// be tested and benchmarked on machines without a GPU.
+//
+// The guide is the luma of the input. At the size of the matte, each pixel's window of (2 * radius + 1) pixels
+// square, clipped to the image, gives the means of the guide I and matte p, and from them
+// a = cov(I, p) / (var(I) + epsilon) and b = mean(p) - a * mean(I). The coefficients are the means of a and b over
+// each pixel's window, and the refined matte at any size is a * I + b, with the coefficients sampled bilinearly at
+// that size and I the luma of the input at that size. Results match the GPU's to within float rounding, as the
+// sums are taken in a different order. The D3D11 stand-in runs the filter in place of MatteShader.hlsl and technique
+// 3 of the output shaders, and bench/ReferenceCheck.cpp checks it against the shaders' arithmetic.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The guide for a colour, as the shaders compute it: Rec. 709 luma
+inline float guideLuma(float r, float g, float b)
+{
+    return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+}
+
+// Pitches are in bytes. (guide) and (matte) are (width) x (height), the guide's luma and the matte's 8 bit alpha;
+// (coefficients) gets a and b of each pixel, one after the other.
+void guidedFilterCoefficients(const float* guide, size_t guidePitch, const uint8_t* matte, size_t mattePitch, float* coefficients, size_t coefficientsPitch,
+    uint32_t width, uint32_t height, uint32_t radius, float epsilon);
+// Refines the matte of (coefficients), (width) x (height), against (input), a BGRA8 image of (inputWidth) x
+// (inputHeight), into (matte) at the size of the input, saturated to [0, 1]
+void guidedFilterUpsample(const float* coefficients, size_t coefficientsPitch, uint32_t width, uint32_t height, const uint8_t* input, size_t inputPitch,
+    float* matte, size_t mattePitch, uint32_t inputWidth, uint32_t inputHeight);
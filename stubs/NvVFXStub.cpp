@@ -0,0 +1,758 @@
+// CPU stand-ins for the NvVFX and NvCVImage entry points the app uses. Link this instead of the SDK proxies in
+// nvvfx/src. Images live in host memory, D3D11 textures are the D3D11 stand-in's, and Cuda streams are CpuStream
+// objects. Effects don't run any model: they copy their input to their output, resampled for upscaling effects,
+// except the green screen effect which writes a mask of whatever isn't green, and the background blur effect which
+// blurs its input wherever the mask it is given is clear.
+
+#include "win32/d3d11.h"
+#include "../nvvfx/include/nvVideoEffects.h"
+#include "../nvvfx/include/nvTransferD3D11.h"
+
+#include "CpuStream.h"
+#include "Stubs.h"
+#include "StubPixels.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    std::atomic<int64_t> g_runDelayUs{ 0 };
+    std::atomic<int64_t> g_loadDelayUs{ 0 };
+
+    unsigned componentCount(NvCVImage_PixelFormat format)
+    {
+        switch (format)
+        {
+        case NVCV_Y:
+        case NVCV_A: return 1;
+        case NVCV_YA: return 2;
+        case NVCV_RGB:
+        case NVCV_BGR: return 3;
+        case NVCV_RGBA:
+        case NVCV_BGRA: return 4;
+        default: return 0;
+        }
+    }
+
+    unsigned componentSize(NvCVImage_ComponentType type)
+    {
+        switch (type)
+        {
+        case NVCV_U8: return 1;
+        case NVCV_U16:
+        case NVCV_F16: return 2;
+        case NVCV_F32: return 4;
+        default: return 0;
+        }
+    }
+
+    bool isFloat(NvCVImage_ComponentType type)
+    {
+        return type == NVCV_F16 || type == NVCV_F32;
+    }
+
+    float componentMax(NvCVImage_ComponentType type)
+    {
+        return type == NVCV_U8 ? 255.f : type == NVCV_U16 ? 65535.f : 1.f;
+    }
+
+    // Which of R, G, B, A (0-3) each component of a pixel is; 4 is luminance
+    std::array<int, 4> componentChannels(NvCVImage_PixelFormat format)
+    {
+        switch (format)
+        {
+        case NVCV_Y: return { 4 };
+        case NVCV_A: return { 3 };
+        case NVCV_YA: return { 4, 3 };
+        case NVCV_RGB: return { 0, 1, 2 };
+        case NVCV_BGR: return { 2, 1, 0 };
+        case NVCV_RGBA: return { 0, 1, 2, 3 };
+        case NVCV_BGRA: return { 2, 1, 0, 3 };
+        default: return {};
+        }
+    }
+
+    // What a transfer or effect needs of an image, copied so work queued on a stream doesn't depend on the
+    // NvCVImage it was given, which is often a view on the caller's stack
+    struct Pixels
+    {
+        explicit Pixels(const NvCVImage& image)
+            : width(image.width)
+            , height(image.height)
+            // Cuda arrays have no pitch of their own, the D3D11 stand-in's textures they are mapped from have packed rows
+            , pitch(image.gpuMem == NVCV_CUDA_ARRAY && !image.pitch ? int(image.width * image.pixelBytes) : image.pitch)
+            , format(image.pixelFormat)
+            , type(image.componentType)
+            , planar(image.planar == NVCV_PLANAR)
+            , numComponents(image.numComponents)
+            , componentBytes(image.componentBytes)
+            , pixels(static_cast<uint8_t*>(image.pixels))
+        {
+        }
+
+        bool sameLayout(const Pixels& other) const
+        {
+            return width == other.width && format == other.format && type == other.type && planar == other.planar;
+        }
+
+        uint8_t* component(unsigned x, unsigned y, unsigned c) const
+        {
+            if (planar)
+                return pixels + (ptrdiff_t(c) * height + y) * pitch + ptrdiff_t(x) * componentBytes;
+            return pixels + ptrdiff_t(y) * pitch + (ptrdiff_t(x) * numComponents + c) * componentBytes;
+        }
+
+        unsigned width, height;
+        int pitch;
+        NvCVImage_PixelFormat format;
+        NvCVImage_ComponentType type;
+        bool planar;
+        unsigned numComponents, componentBytes;
+        uint8_t* pixels;
+    };
+
+    using Texel = std::array<float, 4>; // RGBA, normalised for integer components
+
+    float readComponent(NvCVImage_ComponentType type, const uint8_t* p)
+    {
+        switch (type)
+        {
+        case NVCV_U8: return *p / 255.f;
+        case NVCV_U16: { uint16_t v; std::memcpy(&v, p, 2); return v / 65535.f; }
+        case NVCV_F16: { uint16_t v; std::memcpy(&v, p, 2); return stubHalfToFloat(v); }
+        case NVCV_F32: { float v; std::memcpy(&v, p, 4); return v; }
+        default: return 0.f;
+        }
+    }
+
+    void writeComponent(NvCVImage_ComponentType type, float value, uint8_t* p)
+    {
+        switch (type)
+        {
+        case NVCV_U8: *p = uint8_t(stubFloatToUnorm(value, 255.f)); break;
+        case NVCV_U16: { const uint16_t v = uint16_t(stubFloatToUnorm(value, 65535.f)); std::memcpy(p, &v, 2); break; }
+        case NVCV_F16: { const uint16_t v = stubFloatToHalf(value); std::memcpy(p, &v, 2); break; }
+        case NVCV_F32: std::memcpy(p, &value, 4); break;
+        default: break;
+        }
+    }
+
+    // Reads the texels (xs) of row (y); (xs) null reads the whole row
+    void readTexels(const Pixels& image, unsigned y, const unsigned* xs, unsigned count, Texel* out)
+    {
+        const std::array<int, 4> channels = componentChannels(image.format);
+        for (unsigned i = 0; i < count; ++i)
+        {
+            const unsigned x = xs ? xs[i] : i;
+            Texel t = { 0.f, 0.f, 0.f, 1.f };
+            for (unsigned c = 0; c < image.numComponents; ++c)
+            {
+                const float value = readComponent(image.type, image.component(x, y, c));
+                if (channels[c] == 4)
+                    t[0] = t[1] = t[2] = value;
+                else
+                    t[channels[c]] = value;
+            }
+            out[i] = t;
+        }
+    }
+
+    void writeTexels(const Pixels& image, unsigned y, const Texel* in, float scale)
+    {
+        const std::array<int, 4> channels = componentChannels(image.format);
+        for (unsigned x = 0; x < image.width; ++x)
+        {
+            const Texel& t = in[x];
+            for (unsigned c = 0; c < image.numComponents; ++c)
+            {
+                const float value = channels[c] == 4 ? 0.299f * t[0] + 0.587f * t[1] + 0.114f * t[2] : t[channels[c]];
+                writeComponent(image.type, value * scale, image.component(x, y, c));
+            }
+        }
+    }
+
+    void copyRows(const Pixels& src, const Pixels& dst)
+    {
+        const unsigned rows = src.planar ? src.height * src.numComponents : src.height;
+        const size_t rowBytes = size_t(src.width) * src.componentBytes * (src.planar ? 1 : src.numComponents);
+        for (unsigned y = 0; y < rows; ++y)
+            std::memcpy(dst.pixels + ptrdiff_t(y) * dst.pitch, src.pixels + ptrdiff_t(y) * src.pitch, rowBytes);
+    }
+
+    // Reorders the components of 8 bit chunky images, filling in alpha where (src) has none. Returns false if
+    // a component of (dst) can't be taken straight from (src).
+    bool swizzleU8(const Pixels& src, const Pixels& dst)
+    {
+        if (src.type != NVCV_U8 || dst.type != NVCV_U8 || src.planar || dst.planar)
+            return false;
+        const std::array<int, 4> srcChannels = componentChannels(src.format);
+        const std::array<int, 4> dstChannels = componentChannels(dst.format);
+        int from[4] = { -1, -1, -1, -1 }; // Component of src for each component of dst, -1 for opaque
+        for (unsigned c = 0; c < dst.numComponents; ++c)
+        {
+            for (unsigned s = 0; s < src.numComponents; ++s)
+            {
+                if (srcChannels[s] == dstChannels[c])
+                    from[c] = int(s);
+            }
+            if (from[c] < 0 && dstChannels[c] != 3)
+                return false;
+        }
+        for (unsigned y = 0; y < src.height; ++y)
+        {
+            const uint8_t* in = src.pixels + ptrdiff_t(y) * src.pitch;
+            uint8_t* out = dst.pixels + ptrdiff_t(y) * dst.pitch;
+            for (unsigned x = 0; x < src.width; ++x, in += src.numComponents, out += dst.numComponents)
+            {
+                for (unsigned c = 0; c < dst.numComponents; ++c)
+                    out[c] = from[c] < 0 ? 255 : in[from[c]];
+            }
+        }
+        return true;
+    }
+
+    // Converts (src) to (dst), which must be the same size. As NvCVImage_Transfer, (scale) only applies when
+    // one image has floating point components and the other doesn't.
+    void transferPixels(const Pixels& src, const Pixels& dst, float scale)
+    {
+        if (src.sameLayout(dst) && src.height == dst.height)
+        {
+            copyRows(src, dst);
+            return;
+        }
+        if (swizzleU8(src, dst))
+            return;
+        // Scale is applied to normalised values, which carry the integer side's range
+        float normalisedScale = 1.f;
+        if (!isFloat(src.type) && isFloat(dst.type))
+            normalisedScale = scale * componentMax(src.type);
+        else if (isFloat(src.type) && !isFloat(dst.type))
+            normalisedScale = scale / componentMax(dst.type);
+
+        std::vector<Texel> row(src.width);
+        for (unsigned y = 0; y < src.height; ++y)
+        {
+            readTexels(src, y, nullptr, src.width, row.data());
+            writeTexels(dst, y, row.data(), normalisedScale);
+        }
+    }
+
+    // Nearest neighbour resampling of (src) to (dst), in the same way as the effects' models are sized
+    void resamplePixels(const Pixels& src, const Pixels& dst)
+    {
+        if (src.width == dst.width && src.height == dst.height)
+        {
+            transferPixels(src, dst, 1.f);
+            return;
+        }
+        std::vector<unsigned> xs(dst.width);
+        for (unsigned x = 0; x < dst.width; ++x)
+            xs[x] = std::min(unsigned(uint64_t(x) * src.width / dst.width), src.width - 1);
+        if (src.format == dst.format && src.type == dst.type && src.planar == dst.planar)
+        {
+            // Same format, so texels are copied as they are, plane by plane
+            const unsigned planes = src.planar ? src.numComponents : 1;
+            const unsigned texelBytes = src.planar ? src.componentBytes : src.componentBytes * src.numComponents;
+            for (unsigned plane = 0; plane < planes; ++plane)
+            {
+                for (unsigned y = 0; y < dst.height; ++y)
+                {
+                    const unsigned sy = std::min(unsigned(uint64_t(y) * src.height / dst.height), src.height - 1);
+                    const uint8_t* in = src.pixels + (ptrdiff_t(plane) * src.height + sy) * src.pitch;
+                    uint8_t* out = dst.pixels + (ptrdiff_t(plane) * dst.height + y) * dst.pitch;
+                    for (unsigned x = 0; x < dst.width; ++x)
+                        std::memcpy(out + size_t(x) * texelBytes, in + size_t(xs[x]) * texelBytes, texelBytes);
+                }
+            }
+            return;
+        }
+        std::vector<Texel> row(dst.width);
+        for (unsigned y = 0; y < dst.height; ++y)
+        {
+            readTexels(src, std::min(unsigned(uint64_t(y) * src.height / dst.height), src.height - 1), xs.data(), dst.width, row.data());
+            writeTexels(dst, y, row.data(), 1.f);
+        }
+    }
+
+    // Opaque where the input isn't mostly green
+    void greenScreenPixels(const Pixels& src, const Pixels& dst)
+    {
+        std::vector<unsigned> xs(dst.width);
+        for (unsigned x = 0; x < dst.width; ++x)
+            xs[x] = std::min(unsigned(uint64_t(x) * src.width / dst.width), src.width - 1);
+        std::vector<Texel> row(dst.width);
+        for (unsigned y = 0; y < dst.height; ++y)
+        {
+            readTexels(src, std::min(unsigned(uint64_t(y) * src.height / dst.height), src.height - 1), xs.data(), dst.width, row.data());
+            for (Texel& t : row)
+            {
+                const float matte = t[1] > 0.5f && t[1] > 1.5f * std::max(t[0], t[2]) ? 0.f : 1.f;
+                t = { matte, matte, matte, matte };
+            }
+            writeTexels(dst, y, row.data(), 1.f);
+        }
+    }
+
+    // (src) where (mask) is opaque, box blurred where it is clear. All three are the same size.
+    void backgroundBlurPixels(const Pixels& src, const Pixels& mask, const Pixels& dst)
+    {
+        static constexpr int RADIUS = 4;
+        const int width = int(src.width), height = int(src.height);
+        std::vector<Texel> image(size_t(width) * height), rows(image.size());
+        for (int y = 0; y < height; ++y)
+            readTexels(src, unsigned(y), nullptr, unsigned(width), &image[size_t(y) * width]);
+        // Rows then columns, the window clipped to the image
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                Texel sum = {};
+                const int first = std::max(0, x - RADIUS), last = std::min(width - 1, x + RADIUS);
+                for (int i = first; i <= last; ++i)
+                {
+                    for (int c = 0; c < 4; ++c)
+                        sum[c] += image[size_t(y) * width + i][c];
+                }
+                for (int c = 0; c < 4; ++c)
+                    rows[size_t(y) * width + x][c] = sum[c] / float(last - first + 1);
+            }
+        }
+        std::vector<Texel> row(width), matte(width);
+        for (int y = 0; y < height; ++y)
+        {
+            readTexels(mask, unsigned(y), nullptr, unsigned(width), matte.data());
+            const int first = std::max(0, y - RADIUS), last = std::min(height - 1, y + RADIUS);
+            for (int x = 0; x < width; ++x)
+            {
+                const Texel& original = image[size_t(y) * width + x];
+                const float opacity = matte[x][3];
+                for (int c = 0; c < 4; ++c)
+                {
+                    float sum = 0.f;
+                    for (int i = first; i <= last; ++i)
+                        sum += rows[size_t(i) * width + x][c];
+                    row[x][c] = original[c] * opacity + sum / float(last - first + 1) * (1.f - opacity);
+                }
+            }
+            writeTexels(dst, unsigned(y), row.data(), 1.f);
+        }
+    }
+
+    // The (n)th image of a batch of (batchSize), see nthImage in the app
+    Pixels nthPixels(const Pixels& batch, unsigned n, unsigned batchSize)
+    {
+        Pixels image = batch;
+        image.height = batch.height / batchSize;
+        image.pixels += ptrdiff_t(n) * image.height * (batch.planar ? batch.numComponents : 1) * batch.pitch;
+        return image;
+    }
+
+    void releaseTexture(void* texture)
+    {
+        static_cast<ID3D11Texture2D*>(texture)->Release();
+    }
+
+    // D3D11 textures keep the texture in deletePtr, and only have pixels while mapped
+    ID3D11Texture2D* textureOf(const NvCVImage* im)
+    {
+        return im && im->deleteProc == releaseTexture ? static_cast<ID3D11Texture2D*>(im->deletePtr) : nullptr;
+    }
+
+    void runOn(CUstream stream, std::function<void()> work)
+    {
+        if (stream)
+            toCpuStream(stream)->enqueue(std::move(work));
+        else
+            work();
+    }
+
+    const std::pair<DXGI_FORMAT, std::array<int, 3>> d3dFormats[] = {
+        { DXGI_FORMAT_B8G8R8A8_UNORM, { NVCV_BGRA, NVCV_U8, NVCV_CHUNKY } },
+        { DXGI_FORMAT_B8G8R8X8_UNORM, { NVCV_BGRA, NVCV_U8, NVCV_CHUNKY } },
+        { DXGI_FORMAT_R8G8B8A8_UNORM, { NVCV_RGBA, NVCV_U8, NVCV_CHUNKY } },
+        { DXGI_FORMAT_R16G16B16A16_UNORM, { NVCV_RGBA, NVCV_U16, NVCV_CHUNKY } },
+        { DXGI_FORMAT_R16G16B16A16_FLOAT, { NVCV_RGBA, NVCV_F16, NVCV_CHUNKY } },
+        { DXGI_FORMAT_R32G32B32A32_FLOAT, { NVCV_RGBA, NVCV_F32, NVCV_CHUNKY } },
+        { DXGI_FORMAT_A8_UNORM, { NVCV_A, NVCV_U8, NVCV_CHUNKY } },
+        { DXGI_FORMAT_R8_UNORM, { NVCV_Y, NVCV_U8, NVCV_CHUNKY } },
+        { DXGI_FORMAT_R16_UNORM, { NVCV_Y, NVCV_U16, NVCV_CHUNKY } },
+        { DXGI_FORMAT_R16_FLOAT, { NVCV_Y, NVCV_F16, NVCV_CHUNKY } },
+        { DXGI_FORMAT_R32_FLOAT, { NVCV_Y, NVCV_F32, NVCV_CHUNKY } },
+    };
+}
+
+void nvvfxStubSetDelays(std::chrono::microseconds run, std::chrono::microseconds load)
+{
+    g_runDelayUs = run.count();
+    g_loadDelayUs = load.count();
+}
+
+extern "C" {
+
+NvCV_Status NvCV_API NvCVImage_Init(NvCVImage* im, unsigned width, unsigned height, int pitch, void* pixels, NvCVImage_PixelFormat format,
+    NvCVImage_ComponentType type, unsigned layout, unsigned memSpace)
+{
+    if (!im)
+        return NVCV_ERR_PARAMETER;
+    const unsigned numComponents = componentCount(format);
+    const unsigned componentBytes = componentSize(type);
+    if ((format != NVCV_FORMAT_UNKNOWN && !numComponents) || (type != NVCV_TYPE_UNKNOWN && !componentBytes) || layout > NVCV_PLANAR)
+        return NVCV_ERR_PIXELFORMAT;
+    im->width = width;
+    im->height = height;
+    im->pitch = pitch;
+    im->pixelFormat = format;
+    im->componentType = type;
+    im->numComponents = (unsigned char)numComponents;
+    im->componentBytes = (unsigned char)componentBytes;
+    im->pixelBytes = (unsigned char)(layout == NVCV_PLANAR ? componentBytes : componentBytes * numComponents);
+    im->planar = (unsigned char)layout;
+    im->gpuMem = (unsigned char)memSpace;
+    im->colorspace = 0;
+    im->reserved[0] = im->reserved[1] = 0;
+    im->pixels = pixels;
+    im->deletePtr = nullptr;
+    im->deleteProc = nullptr;
+    im->bufferBytes = 0;
+    return NVCV_SUCCESS;
+}
+
+void NvCV_API NvCVImage_InitView(NvCVImage* subImg, NvCVImage* fullImg, int x, int y, unsigned width, unsigned height)
+{
+    NvCVImage_Init(subImg, width, height, fullImg->pitch,
+        fullImg->pixels ? static_cast<uint8_t*>(fullImg->pixels) + ptrdiff_t(y) * fullImg->pitch + ptrdiff_t(x) * fullImg->pixelBytes : nullptr,
+        fullImg->pixelFormat, fullImg->componentType, fullImg->planar, fullImg->gpuMem);
+}
+
+NvCV_Status NvCV_API NvCVImage_Alloc(NvCVImage* im, unsigned width, unsigned height, NvCVImage_PixelFormat format, NvCVImage_ComponentType type,
+    unsigned layout, unsigned memSpace, unsigned alignment)
+{
+    const NvCV_Status status = NvCVImage_Init(im, width, height, 0, nullptr, format, type, layout, memSpace);
+    if (status != NVCV_SUCCESS || width == 0 || height == 0 || format == NVCV_FORMAT_UNKNOWN)
+        return status;
+    if (alignment == 0)
+        alignment = 32;
+    im->pitch = int((width * im->pixelBytes + alignment - 1) / alignment * alignment);
+    im->bufferBytes = uint64_t(im->pitch) * height * (layout == NVCV_PLANAR ? im->numComponents : 1);
+    im->deletePtr = std::calloc(im->bufferBytes, 1);
+    if (!im->deletePtr)
+        return NVCV_ERR_MEMORY;
+    im->pixels = im->deletePtr;
+    ++stubCounters().imagesAllocated;
+    stubCounters().imageBytes += im->bufferBytes;
+    return NVCV_SUCCESS;
+}
+
+void NvCV_API NvCVImage_Dealloc(NvCVImage* im)
+{
+    if (!im)
+        return;
+    if (im->deletePtr)
+    {
+        if (im->deleteProc)
+            im->deleteProc(im->deletePtr);
+        else
+            std::free(im->deletePtr);
+    }
+    im->pixels = nullptr;
+    im->deletePtr = nullptr;
+    im->deleteProc = nullptr;
+    im->bufferBytes = 0;
+}
+
+NvCV_Status NvCV_API NvCVImage_Realloc(NvCVImage* im, unsigned width, unsigned height, NvCVImage_PixelFormat format, NvCVImage_ComponentType type,
+    unsigned layout, unsigned memSpace, unsigned alignment)
+{
+    NvCVImage_Dealloc(im);
+    return NvCVImage_Alloc(im, width, height, format, type, layout, memSpace, alignment);
+}
+
+NvCV_Status NvCV_API NvCVImage_Transfer(const NvCVImage* src, NvCVImage* dst, float scale, struct CUstream_st* stream, NvCVImage* /*tmp*/)
+{
+    StubHeapScope heapScope;
+    if (!src || !dst || !src->pixels || !dst->pixels)
+        return NVCV_ERR_BUFFER;
+    if (src->width != dst->width || src->height != dst->height)
+        return NVCV_ERR_MISMATCH;
+    if (!componentCount(src->pixelFormat) || !componentCount(dst->pixelFormat) || src->planar > NVCV_PLANAR || dst->planar > NVCV_PLANAR)
+        return NVCV_ERR_PIXELFORMAT;
+    ++stubCounters().transfers;
+    const Pixels from(*src), to(*dst);
+    runOn(stream, [from, to, scale]() { transferPixels(from, to, scale); });
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvCV_API NvCVImage_MapResource(NvCVImage* im, struct CUstream_st* /*stream*/)
+{
+    ID3D11Texture2D* texture = textureOf(im);
+    if (!texture)
+        return NVCV_ERR_PARAMETER;
+    ++stubCounters().mapCalls;
+    ++stubCounters().mappedResources;
+    im->pixels = texture->stubData.data();
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvCV_API NvCVImage_UnmapResource(NvCVImage* im, struct CUstream_st* stream)
+{
+    StubHeapScope heapScope;
+    ID3D11Texture2D* texture = textureOf(im);
+    if (!texture || !im->pixels)
+        return NVCV_ERR_PARAMETER;
+    ++stubCounters().unmapCalls;
+    im->pixels = nullptr;
+    if (stream)
+    {
+        // D3D waits for the work queued on the stream so far before it next uses the texture
+        const CpuStream::Marker marker = toCpuStream(stream)->mark();
+        std::function<void()> previous = std::move(texture->stubPending);
+        texture->stubPending = [previous, marker]()
+        {
+            if (previous)
+                previous();
+            marker.wait();
+        };
+    }
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvCV_API NvCVImage_InitFromD3D11Texture(NvCVImage* im, struct ID3D11Texture2D* tx)
+{
+    if (!im || !tx)
+        return NVCV_ERR_PARAMETER;
+    NvCVImage_PixelFormat format;
+    NvCVImage_ComponentType type;
+    unsigned char layout;
+    if (NvCVImage_FromD3DFormat(tx->stubDesc.Format, &format, &type, &layout) != NVCV_SUCCESS)
+        return NVCV_ERR_PIXELFORMAT;
+    NvCVImage_Dealloc(im);
+    NvCVImage_Init(im, tx->stubDesc.Width, tx->stubDesc.Height, int(tx->stubPitch), nullptr, format, type, layout, NVCV_CUDA_ARRAY);
+    tx->AddRef();
+    im->deletePtr = tx;
+    im->deleteProc = releaseTexture;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvCV_API NvCVImage_ToD3DFormat(NvCVImage_PixelFormat format, NvCVImage_ComponentType type, unsigned layout, DXGI_FORMAT* d3dFormat)
+{
+    for (const auto& [d3d, nvcv] : d3dFormats)
+    {
+        if (nvcv[0] == format && nvcv[1] == type && unsigned(nvcv[2]) == layout)
+        {
+            *d3dFormat = d3d;
+            return NVCV_SUCCESS;
+        }
+    }
+    return NVCV_ERR_PIXELFORMAT;
+}
+
+NvCV_Status NvCV_API NvCVImage_FromD3DFormat(DXGI_FORMAT d3dFormat, NvCVImage_PixelFormat* format, NvCVImage_ComponentType* type, unsigned char* layout)
+{
+    for (const auto& [d3d, nvcv] : d3dFormats)
+    {
+        if (d3d == d3dFormat)
+        {
+            *format = NvCVImage_PixelFormat(nvcv[0]);
+            *type = NvCVImage_ComponentType(nvcv[1]);
+            *layout = (unsigned char)nvcv[2];
+            return NVCV_SUCCESS;
+        }
+    }
+    return NVCV_ERR_PIXELFORMAT;
+}
+
+} // extern "C"
+
+struct NvVFX_Object
+{
+    std::string selector;
+    CUstream stream = nullptr;
+    NvCVImage* input = nullptr;
+    NvCVImage* mask = nullptr; // NVVFX_INPUT_IMAGE_1, for the background blur effect
+    NvCVImage* output = nullptr;
+    std::unordered_map<std::string, unsigned int> u32s;
+    std::unordered_map<std::string, float> f32s;
+    bool loaded = false;
+    std::string info;
+};
+
+extern "C" {
+
+NvCV_Status NvVFX_API NvVFX_CreateEffect(NvVFX_EffectSelector code, NvVFX_Handle* effect)
+{
+    StubHeapScope heapScope;
+    static const char* const known[] = { NVVFX_FX_TRANSFER, NVVFX_FX_GREEN_SCREEN, NVVFX_FX_BGBLUR, NVVFX_FX_ARTIFACT_REDUCTION,
+        NVVFX_FX_SUPER_RES, NVVFX_FX_SR_UPSCALE, NVVFX_FX_DENOISING };
+    if (!code || !effect || std::none_of(std::begin(known), std::end(known), [&](const char* name) { return std::strcmp(name, code) == 0; }))
+        return NVCV_ERR_FEATURENOTFOUND;
+    *effect = new NvVFX_Object();
+    (*effect)->selector = code;
+    (*effect)->info = std::string(code) + " (CPU stand-in)";
+    return NVCV_SUCCESS;
+}
+
+void NvVFX_API NvVFX_DestroyEffect(NvVFX_Handle effect)
+{
+    delete effect;
+}
+
+NvCV_Status NvVFX_API NvVFX_SetU32(NvVFX_Handle effect, NvVFX_ParameterSelector paramName, unsigned int val)
+{
+    StubHeapScope heapScope;
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    effect->u32s[paramName] = val;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_GetU32(NvVFX_Handle effect, NvVFX_ParameterSelector paramName, unsigned int* val)
+{
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    const auto it = effect->u32s.find(paramName);
+    if (it == effect->u32s.end())
+        return NVCV_ERR_SELECTOR;
+    *val = it->second;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_SetF32(NvVFX_Handle effect, NvVFX_ParameterSelector paramName, float val)
+{
+    StubHeapScope heapScope;
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    effect->f32s[paramName] = val;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_GetF32(NvVFX_Handle effect, NvVFX_ParameterSelector paramName, float* val)
+{
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    const auto it = effect->f32s.find(paramName);
+    if (it == effect->f32s.end())
+        return NVCV_ERR_SELECTOR;
+    *val = it->second;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_SetCudaStream(NvVFX_Handle effect, NvVFX_ParameterSelector /*paramName*/, CUstream stream)
+{
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    effect->stream = stream;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_SetImage(NvVFX_Handle effect, NvVFX_ParameterSelector paramName, NvCVImage* im)
+{
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    if (std::strcmp(paramName, NVVFX_INPUT_IMAGE) == 0)
+        effect->input = im;
+    else if (std::strcmp(paramName, NVVFX_INPUT_IMAGE_1) == 0)
+        effect->mask = im;
+    else if (std::strcmp(paramName, NVVFX_OUTPUT_IMAGE) == 0)
+        effect->output = im;
+    else
+        return NVCV_ERR_SELECTOR;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_GetString(NvVFX_Handle effect, NvVFX_ParameterSelector paramName, const char** str)
+{
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    if (std::strcmp(paramName, NVVFX_INFO) != 0)
+        return NVCV_ERR_SELECTOR;
+    *str = effect->info.c_str();
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_Load(NvVFX_Handle effect)
+{
+    StubHeapScope heapScope;
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    if (!effect->input || !effect->output)
+        return NVCV_ERR_MISSINGINPUT;
+    std::this_thread::sleep_for(std::chrono::microseconds(g_loadDelayUs.load()));
+    ++stubCounters().effectLoads;
+    effect->loaded = true;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_Run(NvVFX_Handle effect, int /*async*/)
+{
+    StubHeapScope heapScope;
+    if (!effect)
+        return NVCV_ERR_EFFECT;
+    if (!effect->loaded)
+        return NVCV_ERR_INITIALIZATION;
+    if (!effect->input || !effect->output || !effect->input->pixels || !effect->output->pixels)
+        return NVCV_ERR_MISSINGINPUT;
+    const auto batch = effect->u32s.find(NVVFX_BATCH_SIZE);
+    const unsigned batchSize = batch == effect->u32s.end() ? 1 : std::max(1u, batch->second);
+    if (effect->input->height % batchSize != 0 || effect->output->height % batchSize != 0)
+        return NVCV_ERR_RESOLUTION;
+    // An effect given a scale factor must be given an output of the input size scaled by it
+    const auto scale = effect->f32s.find(NVVFX_SCALE);
+    if (scale != effect->f32s.end() && (long(effect->output->width) != std::lround(effect->input->width * scale->second)
+        || long(effect->output->height / batchSize) != std::lround(effect->input->height / batchSize * scale->second)))
+        return NVCV_ERR_RESOLUTION;
+    // The background blur effect blurs by a mask of its input's size, which it doesn't scale
+    const bool backgroundBlur = effect->selector == NVVFX_FX_BGBLUR;
+    if (backgroundBlur && (!effect->mask || !effect->mask->pixels))
+        return NVCV_ERR_MISSINGINPUT;
+    if (backgroundBlur && (effect->mask->width != effect->input->width || effect->mask->height != effect->input->height
+        || effect->output->width != effect->input->width || effect->output->height != effect->input->height))
+        return NVCV_ERR_RESOLUTION;
+    ++stubCounters().effectRuns;
+
+    const Pixels input(*effect->input), output(*effect->output);
+    const Pixels mask = backgroundBlur ? Pixels(*effect->mask) : input;
+    const bool greenScreen = effect->selector == NVVFX_FX_GREEN_SCREEN;
+    const std::chrono::microseconds delay(g_runDelayUs.load());
+    runOn(effect->stream, [input, mask, output, batchSize, greenScreen, backgroundBlur, delay]()
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < batchSize; ++i)
+        {
+            if (backgroundBlur)
+                backgroundBlurPixels(nthPixels(input, i, batchSize), nthPixels(mask, i, batchSize), nthPixels(output, i, batchSize));
+            else if (greenScreen)
+                greenScreenPixels(nthPixels(input, i, batchSize), nthPixels(output, i, batchSize));
+            else
+                resamplePixels(nthPixels(input, i, batchSize), nthPixels(output, i, batchSize));
+        }
+        // Inference takes at least as long as asked for, however long the copy took
+        std::this_thread::sleep_until(start + delay);
+    });
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_CudaStreamCreate(CUstream* stream)
+{
+    StubHeapScope heapScope;
+    if (!stream)
+        return NVCV_ERR_PARAMETER;
+    *stream = reinterpret_cast<CUstream>(new CpuStream());
+    stubCudaInitialised() = true;
+    return NVCV_SUCCESS;
+}
+
+NvCV_Status NvVFX_API NvVFX_CudaStreamDestroy(CUstream stream)
+{
+    if (!stream)
+        return NVCV_ERR_PARAMETER;
+    delete toCpuStream(stream);
+    return NVCV_SUCCESS;
+}
+
+} // extern "C"
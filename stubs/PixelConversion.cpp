@@ -0,0 +1,163 @@
+#include "PixelConversion.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#define PIXEL_CONVERSION_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PIXEL_CONVERSION_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PIXEL_CONVERSION_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    template <typename T>
+    T* row(T* base, size_t pitch, size_t y)
+    {
+        return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(base) + y * pitch);
+    }
+
+    float unormToFloat(uint8_t c)
+    {
+        return float(c) / 255.f;
+    }
+
+    uint32_t floatToUnorm(float f)
+    {
+        const float saturated = f > 0.f ? (f < 1.f ? f : 1.f) : 0.f; // NaN fails both comparisons
+        return uint32_t(std::lrint(saturated * 255.f)); // Default rounding mode is to nearest even
+    }
+
+    // Converts (x) onwards of a row, returns how far it got
+    size_t bgra8ToPlanarF32Simd(const uint8_t* src, float* b, float* g, float* r, size_t width)
+    {
+        size_t x = 0;
+#if defined(PIXEL_CONVERSION_AVX2)
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m256 scale = _mm256_set1_ps(255.f);
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + x * 4));
+            _mm256_storeu_ps(b + x, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(pixels, mask)), scale));
+            _mm256_storeu_ps(g + x, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 8), mask)), scale));
+            _mm256_storeu_ps(r + x, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(pixels, 16), mask)), scale));
+        }
+#elif defined(PIXEL_CONVERSION_SSE2)
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128 scale = _mm_set1_ps(255.f);
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 4));
+            _mm_storeu_ps(b + x, _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(pixels, mask)), scale));
+            _mm_storeu_ps(g + x, _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask)), scale));
+            _mm_storeu_ps(r + x, _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), mask)), scale));
+        }
+#elif defined(PIXEL_CONVERSION_NEON)
+        const uint32x4_t mask = vdupq_n_u32(0xff);
+        const float32x4_t scale = vdupq_n_f32(255.f);
+        for (; x + 4 <= width; x += 4)
+        {
+            const uint32x4_t pixels = vreinterpretq_u32_u8(vld1q_u8(src + x * 4));
+            vst1q_f32(b + x, vdivq_f32(vcvtq_f32_u32(vandq_u32(pixels, mask)), scale));
+            vst1q_f32(g + x, vdivq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(pixels, 8), mask)), scale));
+            vst1q_f32(r + x, vdivq_f32(vcvtq_f32_u32(vandq_u32(vshrq_n_u32(pixels, 16), mask)), scale));
+        }
+#endif
+        return x;
+    }
+
+    size_t planarF32ToBgra8Simd(const float* b, const float* g, const float* r, uint8_t* dst, size_t width)
+    {
+        size_t x = 0;
+#if defined(PIXEL_CONVERSION_AVX2)
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.f);
+        const __m256 scale = _mm256_set1_ps(255.f);
+        const __m256i alpha = _mm256_set1_epi32(int(0xff000000));
+        // max returns its second operand if either is NaN, so NaN saturates to 0
+        const auto toUnorm = [&](const float* plane) { return _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(plane), zero), one), scale)); };
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m256i pixels = _mm256_or_si256(_mm256_or_si256(toUnorm(b + x), _mm256_slli_epi32(toUnorm(g + x), 8)), _mm256_or_si256(_mm256_slli_epi32(toUnorm(r + x), 16), alpha));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), pixels);
+        }
+#elif defined(PIXEL_CONVERSION_SSE2)
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.f);
+        const __m128 scale = _mm_set1_ps(255.f);
+        const __m128i alpha = _mm_set1_epi32(int(0xff000000));
+        // max returns its second operand if either is NaN, so NaN saturates to 0
+        const auto toUnorm = [&](const float* plane) { return _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(plane), zero), one), scale)); };
+        for (; x + 4 <= width; x += 4)
+        {
+            const __m128i pixels = _mm_or_si128(_mm_or_si128(toUnorm(b + x), _mm_slli_epi32(toUnorm(g + x), 8)), _mm_or_si128(_mm_slli_epi32(toUnorm(r + x), 16), alpha));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), pixels);
+        }
+#elif defined(PIXEL_CONVERSION_NEON)
+        const float32x4_t zero = vdupq_n_f32(0.f);
+        const float32x4_t one = vdupq_n_f32(1.f);
+        const float32x4_t scale = vdupq_n_f32(255.f);
+        const uint32x4_t alpha = vdupq_n_u32(0xff000000);
+        // maxnm returns the number if one operand is NaN, so NaN saturates to 0
+        const auto toUnorm = [&](const float* plane) { return vcvtnq_u32_f32(vmulq_f32(vminq_f32(vmaxnmq_f32(vld1q_f32(plane), zero), one), scale)); };
+        for (; x + 4 <= width; x += 4)
+        {
+            const uint32x4_t pixels = vorrq_u32(vorrq_u32(toUnorm(b + x), vshlq_n_u32(toUnorm(g + x), 8)), vorrq_u32(vshlq_n_u32(toUnorm(r + x), 16), alpha));
+            vst1q_u8(dst + x * 4, vreinterpretq_u8_u32(pixels));
+        }
+#endif
+        return x;
+    }
+}
+
+void bgra8ToPlanarF32(const uint8_t* src, size_t srcPitch, float* dst, size_t dstPitch, uint32_t width, uint32_t height)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const uint8_t* in = row(src, srcPitch, y);
+        float* b = row(dst, dstPitch, y);
+        float* g = row(dst, dstPitch, y + height);
+        float* r = row(dst, dstPitch, y + 2 * size_t(height));
+        for (size_t x = bgra8ToPlanarF32Simd(in, b, g, r, width); x < width; ++x)
+        {
+            b[x] = unormToFloat(in[x * 4 + 0]);
+            g[x] = unormToFloat(in[x * 4 + 1]);
+            r[x] = unormToFloat(in[x * 4 + 2]);
+        }
+    }
+}
+
+void planarF32ToBgra8(const float* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        const float* b = row(src, srcPitch, y);
+        const float* g = row(src, srcPitch, y + height);
+        const float* r = row(src, srcPitch, y + 2 * size_t(height));
+        uint8_t* out = row(dst, dstPitch, y);
+        for (size_t x = planarF32ToBgra8Simd(b, g, r, out, width); x < width; ++x)
+        {
+            out[x * 4 + 0] = uint8_t(floatToUnorm(b[x]));
+            out[x * 4 + 1] = uint8_t(floatToUnorm(g[x]));
+            out[x * 4 + 2] = uint8_t(floatToUnorm(r[x]));
+            out[x * 4 + 3] = 0xff;
+        }
+    }
+}
+
+const char* pixelConversionInstructionSet()
+{
+#if defined(PIXEL_CONVERSION_AVX2)
+    return "AVX2";
+#elif defined(PIXEL_CONVERSION_SSE2)
+    return "SSE2";
+#elif defined(PIXEL_CONVERSION_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,21 @@
+// CPU implementations of the conversions between the BGRA8 textures d3 sends and the planar F32 images the
+// Artifact reduction and Super resolution effects take, matching the GPU conversions bit for bit so they can
+// be tested and benchmarked on machines without a GPU. The D3D11 stand-in runs them in place of InputShader.hlsl
+// and the output shaders, and bench/ReferenceCheck.cpp checks them against the shaders' arithmetic.
+//
+// Planar images hold the B, G and R planes one above the other, each (height) rows of (width) floats.
+// Conversions follow the D3D rules for UNORM: to float is c / 255, from float saturates, scales by 255 and
+// rounds to nearest even, with NaN converting to 0. The planar to BGRA8 conversion matches the pixel shader
+// when the output is drawn at its own size, as it then samples texel centres.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Pitches are in bytes
+void bgra8ToPlanarF32(const uint8_t* src, size_t srcPitch, float* dst, size_t dstPitch, uint32_t width, uint32_t height);
+void planarF32ToBgra8(const float* src, size_t srcPitch, uint8_t* dst, size_t dstPitch, uint32_t width, uint32_t height);
+
+// The instruction set the conversions were compiled for: "AVX2", "SSE2", "NEON" or "scalar"
+const char* pixelConversionInstructionSet();
@@ -0,0 +1,589 @@
+// A loopback stand-in for the RenderStream DLL: requests frames of the scenes and sizes a LoopbackScenario asks
+// for, as d3 would, serves image parameters from host memory and records when each frame has been sent back to
+// every stream. Once every frame has been requested and answered (or dropped), rs_awaitFrameData returns
+// RS_NOT_INITIALISED so the app's frame loop ends.
+
+#include "win32/d3d11.h"
+#include "../renderstream/d3renderstream.h"
+
+#include "Stubs.h"
+#include "StubPixels.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct SceneInfo
+    {
+        uint32_t images = 0;
+        std::vector<float> numbers; // Defaults of the scene's numeric parameters, in schema order
+        std::vector<float> alternates; // What each numeric parameter changes to, see LoopbackScenario::framesPerSetting
+        std::vector<std::string> texts; // Defaults of the scene's text parameters, in schema order
+    };
+
+    struct Outstanding
+    {
+        Clock::time_point requested;
+        uint32_t streamsRemaining;
+    };
+
+    struct Loopback
+    {
+        std::mutex mutex;
+        LoopbackScenario scenario;
+        LoopbackResults results;
+        bool initialised = false;
+        bool streamsChanged = true; // Reported by the first rs_awaitFrameData
+        uint64_t streamGeneration = 0; // See LoopbackScenario::streamChangeEvery
+        std::vector<SceneInfo> scenes;
+        std::vector<std::string> channels;
+        std::vector<StreamDescription> streams;
+        std::vector<std::string> streamNames;
+
+        // The current frame, valid until the next rs_awaitFrameData
+        bool haveFrame = false;
+        bool haveCameras = false; // Whether the streams have camera data for it, which is what asks for a frame to be sent
+        uint64_t frame = 0;
+        uint32_t scene = 0;
+        LoopbackScenario::Size size = { 0, 0 };
+
+        std::map<uint64_t, Outstanding> outstanding; // By frame index, which is sent as tTracked
+        std::map<std::tuple<uint32_t, uint32_t, DXGI_FORMAT>, std::vector<uint8_t>> patterns; // Image parameter contents, by size and texture format
+    };
+
+    Loopback& loopback()
+    {
+        static Loopback instance;
+        return instance;
+    }
+
+    void logMessage(Loopback& lb, const char* message)
+    {
+        ++lb.results.logMessages;
+        if (lb.scenario.verbose)
+            std::fprintf(stderr, "[d3] %s", message);
+    }
+
+    LoopbackScenario::Size streamSize(const LoopbackScenario& scenario)
+    {
+        if (scenario.streamSize.width && scenario.streamSize.height)
+            return scenario.streamSize;
+        return scenario.sizes.empty() ? LoopbackScenario::Size{ 640, 360 } : scenario.sizes.front();
+    }
+
+    void buildStreams(Loopback& lb)
+    {
+        const LoopbackScenario::Size size = streamSize(lb.scenario);
+        lb.streams.clear();
+        lb.streamNames.clear();
+        for (uint32_t i = 0; i < lb.scenario.streams; ++i)
+            lb.streamNames.push_back("Loopback " + std::to_string(i + 1));
+        for (uint32_t i = 0; i < lb.scenario.streams; ++i)
+        {
+            // Every other generation the last stream is half the size
+            const bool halved = i + 1 == lb.scenario.streams && lb.streamGeneration % 2 == 1;
+            StreamDescription description = {};
+            description.handle = 1000 + i;
+            description.channel = lb.channels.empty() ? "" : lb.channels[i % lb.channels.size()].c_str();
+            description.name = lb.streamNames[i].c_str();
+            description.width = halved ? std::max(size.width / 2, 1u) : size.width;
+            description.height = halved ? std::max(size.height / 2, 1u) : size.height;
+            description.format = lb.scenario.streamFormat;
+            description.clipping = { 0.f, 1.f, 0.f, 1.f };
+            lb.streams.push_back(description);
+        }
+        lb.streamsChanged = true;
+    }
+
+    // Frames that have gone unsent for too long are dropped, as d3 would show the next frame instead
+    void dropLateFrames(Loopback& lb, Clock::time_point now)
+    {
+        for (auto it = lb.outstanding.begin(); it != lb.outstanding.end();)
+        {
+            if (now - it->second.requested >= lb.scenario.dropAfter)
+            {
+                ++lb.results.dropped;
+                it = lb.outstanding.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // Rows of (width) texels in (format), one of the formats d3 sends image parameters in
+    const std::vector<uint8_t>& pattern(Loopback& lb, uint32_t width, uint32_t height, DXGI_FORMAT format)
+    {
+        std::vector<uint8_t>& pixels = lb.patterns[{ width, height, format }];
+        if (pixels.empty())
+        {
+            const UINT texelBytes = stubFormatBytes(format);
+            pixels.resize(size_t(width) * height * texelBytes);
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    const float b = float(x) / std::max(width - 1, 1u);
+                    const float g = (x / 16 + y / 16) % 2 ? 224.f / 255.f : 32.f / 255.f;
+                    const float r = float(y) / std::max(height - 1, 1u);
+                    uint8_t* p = &pixels[(size_t(y) * width + x) * texelBytes];
+                    if (format == DXGI_FORMAT_R32G32B32A32_FLOAT)
+                    {
+                        const float rgba[4] = { r, g, b, 1.f };
+                        std::memcpy(p, rgba, sizeof(rgba));
+                    }
+                    else if (format == DXGI_FORMAT_R16G16B16A16_UNORM)
+                    {
+                        const uint16_t rgba[4] = { uint16_t(stubFloatToUnorm(r, 65535.f)), uint16_t(stubFloatToUnorm(g, 65535.f)), uint16_t(stubFloatToUnorm(b, 65535.f)), 65535 };
+                        std::memcpy(p, rgba, sizeof(rgba));
+                    }
+                    else
+                    {
+                        p[0] = uint8_t(stubFloatToUnorm(b, 255.f));
+                        p[1] = uint8_t(stubFloatToUnorm(g, 255.f));
+                        p[2] = uint8_t(stubFloatToUnorm(r, 255.f));
+                        p[3] = 255;
+                    }
+                }
+            }
+        }
+        return pixels;
+    }
+
+    DXGI_FORMAT textureFormat(RSPixelFormat format)
+    {
+        switch (format)
+        {
+        case RS_FMT_BGRX8: return DXGI_FORMAT_B8G8R8X8_UNORM;
+        case RS_FMT_RGBA32F: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+        case RS_FMT_RGBA16: return DXGI_FORMAT_R16G16B16A16_UNORM;
+        default: return DXGI_FORMAT_B8G8R8A8_UNORM;
+        }
+    }
+
+    ID3D11Texture2D* textureOf(SenderFrameType frameType, const SenderFrameTypeData& data)
+    {
+        if (frameType != RS_FRAMETYPE_DX11_TEXTURE || !data.dx11.resource)
+            return nullptr;
+        return dynamic_cast<ID3D11Texture2D*>(data.dx11.resource);
+    }
+
+    logger_t g_logger = nullptr;
+    logger_t g_errorLogger = nullptr;
+}
+
+void loopbackConfigure(const LoopbackScenario& scenario)
+{
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    lb.scenario = scenario;
+    if (lb.scenario.sizes.empty())
+        lb.scenario.sizes = { { 640, 360 } };
+    if (lb.scenario.scenes.empty())
+        lb.scenario.scenes = { 0 };
+    lb.scenario.framesPerSize = std::max<uint64_t>(lb.scenario.framesPerSize, 1);
+    lb.scenario.framesPerScene = std::max<uint64_t>(lb.scenario.framesPerScene, 1);
+    lb.scenario.framesPerImage = std::max<uint64_t>(lb.scenario.framesPerImage, 1);
+    lb.scenario.consumeEvery = std::max<uint64_t>(lb.scenario.consumeEvery, 1);
+    lb.scenario.maxOutstanding = std::max(lb.scenario.maxOutstanding, 1u);
+    lb.results = LoopbackResults();
+    lb.outstanding.clear();
+    lb.haveFrame = false;
+    buildStreams(lb);
+}
+
+const LoopbackResults& loopbackResults()
+{
+    return loopback().results;
+}
+
+extern "C" {
+
+void rs_registerLoggingFunc(logger_t logger)
+{
+    g_logger = logger;
+}
+
+void rs_registerErrorLoggingFunc(logger_t logger)
+{
+    g_errorLogger = logger;
+}
+
+RS_ERROR rs_initialise(int expectedVersionMajor, int expectedVersionMinor)
+{
+    if (expectedVersionMajor != RENDER_STREAM_VERSION_MAJOR || expectedVersionMinor > RENDER_STREAM_VERSION_MINOR)
+        return RS_ERROR_INCOMPATIBLE_VERSION;
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    if (lb.initialised)
+        return RS_ERROR_ALREADYINITIALISED;
+    lb.initialised = true;
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_initialiseGpGpuWithDX11Device(ID3D11Device* device)
+{
+    return device ? RS_ERROR_SUCCESS : RS_ERROR_INVALID_PARAMETERS;
+}
+
+RS_ERROR rs_shutdown()
+{
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    if (!lb.initialised)
+        return RS_NOT_INITIALISED;
+    lb.initialised = false;
+    // Anything still unsent never will be
+    lb.results.dropped += lb.outstanding.size();
+    lb.outstanding.clear();
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_saveSchema(const char* assetPath, Schema* schema)
+{
+    return assetPath && schema ? RS_ERROR_SUCCESS : RS_ERROR_INVALID_PARAMETERS;
+}
+
+RS_ERROR rs_setSchema(Schema* schema)
+{
+    StubHeapScope heapScope;
+    if (!schema)
+        return RS_ERROR_INVALID_PARAMETERS;
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    lb.scenes.clear();
+    for (uint32_t i = 0; i < schema->scenes.nScenes; ++i)
+    {
+        RemoteParameters& scene = schema->scenes.scenes[i];
+        scene.hash = i + 1;
+        SceneInfo info;
+        for (uint32_t j = 0; j < scene.nParameters; ++j)
+        {
+            const RemoteParameter& parameter = scene.parameters[j];
+            if (parameter.type == RS_PARAMETER_IMAGE)
+                ++info.images;
+            else if (parameter.type == RS_PARAMETER_TEXT)
+                info.texts.push_back(parameter.defaults.text.defaultValue ? parameter.defaults.text.defaultValue : "");
+            else if (parameter.type == RS_PARAMETER_NUMBER)
+            {
+                const NumericalDefaults& number = parameter.defaults.number;
+                info.numbers.push_back(number.defaultValue);
+                info.alternates.push_back(number.defaultValue == number.max ? number.min : number.max);
+            }
+            else
+            {
+                info.numbers.insert(info.numbers.end(), 16, 0.f); // Matrices
+                info.alternates.insert(info.alternates.end(), 16, 0.f);
+            }
+        }
+        lb.scenes.push_back(std::move(info));
+    }
+    lb.channels.clear();
+    for (uint32_t i = 0; i < schema->channels.nChannels; ++i)
+        lb.channels.push_back(schema->channels.channels[i]);
+    buildStreams(lb);
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_getStreams(StreamDescriptions* streams, uint32_t* nBytes)
+{
+    StubHeapScope heapScope;
+    if (!nBytes)
+        return RS_ERROR_INVALID_PARAMETERS;
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+
+    // The descriptions follow the header and the strings follow the descriptions, all in the caller's buffer
+    size_t required = sizeof(StreamDescriptions) + lb.streams.size() * sizeof(StreamDescription);
+    for (const StreamDescription& description : lb.streams)
+        required += std::strlen(description.channel) + 1 + std::strlen(description.name) + 1;
+    if (!streams || *nBytes < required)
+    {
+        *nBytes = uint32_t(required);
+        return RS_ERROR_BUFFER_OVERFLOW;
+    }
+
+    uint8_t* base = reinterpret_cast<uint8_t*>(streams);
+    streams->nStreams = uint32_t(lb.streams.size());
+    streams->streams = reinterpret_cast<StreamDescription*>(base + sizeof(StreamDescriptions));
+    char* strings = reinterpret_cast<char*>(streams->streams + lb.streams.size());
+    const auto copyString = [&](const char* s) -> const char*
+    {
+        const size_t length = std::strlen(s) + 1;
+        std::memcpy(strings, s, length);
+        const char* copy = strings;
+        strings += length;
+        return copy;
+    };
+    for (size_t i = 0; i < lb.streams.size(); ++i)
+    {
+        streams->streams[i] = lb.streams[i];
+        streams->streams[i].channel = copyString(lb.streams[i].channel);
+        streams->streams[i].name = copyString(lb.streams[i].name);
+    }
+    *nBytes = uint32_t(required);
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_awaitFrameData(int timeoutMs, FrameData* data)
+{
+    StubHeapScope heapScope;
+    if (!data)
+        return RS_ERROR_INVALID_PARAMETERS;
+    Loopback& lb = loopback();
+    std::unique_lock<std::mutex> lock(lb.mutex);
+    if (!lb.initialised)
+        return RS_NOT_INITIALISED;
+    lb.haveFrame = false;
+    if (lb.scenario.streamChangeEvery && lb.results.requested / lb.scenario.streamChangeEvery != lb.streamGeneration)
+    {
+        lb.streamGeneration = lb.results.requested / lb.scenario.streamChangeEvery;
+        buildStreams(lb);
+    }
+    if (lb.streamsChanged)
+    {
+        lb.streamsChanged = false;
+        return RS_ERROR_STREAMS_CHANGED;
+    }
+
+    Clock::time_point now = Clock::now();
+    dropLateFrames(lb, now);
+    const bool finished = lb.results.requested >= lb.scenario.frames;
+    if (finished && lb.outstanding.empty())
+        return RS_NOT_INITIALISED;
+    if (finished || lb.outstanding.size() >= lb.scenario.maxOutstanding)
+    {
+        // d3 doesn't ask for more until it has the frames it is waiting on
+        const Clock::time_point dropAt = lb.outstanding.begin()->second.requested + lb.scenario.dropAfter;
+        lock.unlock();
+        std::this_thread::sleep_until(std::min(now + std::chrono::milliseconds(timeoutMs), dropAt));
+        lock.lock();
+        dropLateFrames(lb, Clock::now());
+        return RS_ERROR_TIMEOUT;
+    }
+
+    if (lb.results.requested == 0 && lb.scenario.onFirstFrame)
+    {
+        lock.unlock();
+        lb.scenario.onFirstFrame();
+        lock.lock();
+        now = Clock::now();
+    }
+
+    const uint64_t frame = lb.results.requested++;
+    if (frame == 0)
+        lb.results.firstRequest = now;
+    lb.haveFrame = true;
+    lb.frame = frame;
+    lb.scene = lb.scenario.scenes[(frame / lb.scenario.framesPerScene) % lb.scenario.scenes.size()];
+    lb.size = lb.scenario.sizes[(frame / lb.scenario.framesPerSize) % lb.scenario.sizes.size()];
+    lb.haveCameras = frame % lb.scenario.consumeEvery == 0;
+    lb.outstanding[frame] = { now, uint32_t(lb.streams.size()) };
+    if (lb.streams.empty() || !lb.haveCameras)
+    {
+        // Nothing to send to, so the frame is complete as soon as it has been requested
+        lb.outstanding.erase(frame);
+        ++lb.results.completed;
+        lb.results.lastCompletion = now;
+        lb.results.latencyMs.push_back(0.);
+    }
+
+    *data = {};
+    data->tTracked = double(frame);
+    data->localTime = double(frame) / 60.;
+    data->localTimeDelta = 1. / 60.;
+    data->frameRateNumerator = 60;
+    data->frameRateDenominator = 1;
+    data->flags = frame == 0 ? FRAMEDATA_RESET : FRAMEDATA_NO_FLAGS;
+    data->scene = lb.scene;
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_getFrameParameters(uint64_t schemaHash, void* outParameterData, uint64_t outParameterDataSize)
+{
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    if (!lb.haveFrame || schemaHash != lb.scene + 1 || lb.scene >= lb.scenes.size())
+        return RS_ERROR_INCORRECTSCHEMA;
+    const SceneInfo& info = lb.scenes[lb.scene];
+    const bool alternate = lb.scenario.framesPerSetting && (lb.frame / lb.scenario.framesPerSetting) % 2 == 1;
+    const std::vector<float>& numbers = alternate ? info.alternates : info.numbers;
+    if (outParameterDataSize != numbers.size() * sizeof(float))
+        return RS_ERROR_INVALID_PARAMETERS;
+    std::memcpy(outParameterData, numbers.data(), outParameterDataSize);
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_getFrameImageData(uint64_t schemaHash, ImageFrameData* outParameterData, uint64_t outParameterDataCount)
+{
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    if (!lb.haveFrame || schemaHash != lb.scene + 1 || lb.scene >= lb.scenes.size())
+        return RS_ERROR_INCORRECTSCHEMA;
+    if (outParameterDataCount != lb.scenes[lb.scene].images)
+        return RS_ERROR_INVALID_PARAMETERS;
+    for (uint64_t i = 0; i < outParameterDataCount; ++i)
+    {
+        outParameterData[i].width = lb.size.width;
+        outParameterData[i].height = lb.size.height;
+        outParameterData[i].format = lb.scenario.imageFormat;
+        outParameterData[i].imageId = int64_t(((lb.frame / lb.scenario.framesPerImage) << 8) | i);
+    }
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_getFrameImage(int64_t imageId, SenderFrameType frameType, SenderFrameTypeData data)
+{
+    StubHeapScope heapScope;
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    if (!lb.haveFrame || uint64_t(imageId) >> 8 != lb.frame / lb.scenario.framesPerImage)
+        return RS_ERROR_NOTFOUND;
+    ID3D11Texture2D* texture = textureOf(frameType, data);
+    if (!texture)
+        return RS_ERROR_BADSTREAMTYPE;
+    const DXGI_FORMAT format = textureFormat(lb.scenario.imageFormat);
+    if (texture->stubDesc.Width != lb.size.width || texture->stubDesc.Height != lb.size.height || texture->stubDesc.Format != format)
+        return RS_ERROR_INVALID_PARAMETERS;
+
+    // As a GPU copy into the texture would, this waits for Cuda work still reading it
+    texture->stubSync();
+    const std::vector<uint8_t>& pixels = pattern(lb, lb.size.width, lb.size.height, format);
+    const size_t rowBytes = size_t(lb.size.width) * stubFormatBytes(format);
+    for (uint32_t y = 0; y < lb.size.height; ++y)
+        std::memcpy(texture->stubData.data() + size_t(y) * texture->stubPitch, pixels.data() + y * rowBytes, rowBytes);
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_getFrameText(uint64_t schemaHash, uint32_t textParamIndex, const char** outTextPtr)
+{
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    if (!lb.haveFrame || schemaHash != lb.scene + 1 || lb.scene >= lb.scenes.size())
+        return RS_ERROR_INCORRECTSCHEMA;
+    const std::vector<std::string>& texts = lb.scenes[lb.scene].texts;
+    if (textParamIndex >= texts.size() || !outTextPtr)
+        return RS_ERROR_INVALID_PARAMETERS;
+    *outTextPtr = texts[textParamIndex].c_str();
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_getFrameCamera(StreamHandle streamHandle, CameraData* outCameraData)
+{
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    if (!lb.haveFrame)
+        return RS_ERROR_NOTFOUND;
+    if (std::none_of(lb.streams.begin(), lb.streams.end(), [&](const StreamDescription& description) { return description.handle == streamHandle; }))
+        return RS_ERROR_INVALIDHANDLE;
+    if (!lb.haveCameras)
+        return RS_ERROR_NOTFOUND;
+    *outCameraData = {};
+    outCameraData->id = streamHandle;
+    outCameraData->focalLength = 30.f;
+    outCameraData->sensorX = 36.f;
+    outCameraData->sensorY = 24.f;
+    outCameraData->nearZ = 0.1f;
+    outCameraData->farZ = 1000.f;
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_sendFrame(StreamHandle streamHandle, SenderFrameType frameType, SenderFrameTypeData data, const CameraResponseData* sendData)
+{
+    StubHeapScope heapScope;
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    const auto stream = std::find_if(lb.streams.begin(), lb.streams.end(), [&](const StreamDescription& description) { return description.handle == streamHandle; });
+    if (stream == lb.streams.end())
+        return RS_ERROR_INVALIDHANDLE;
+    ID3D11Texture2D* texture = textureOf(frameType, data);
+    if (!texture)
+        return RS_ERROR_BADSTREAMTYPE;
+    if (!sendData || texture->stubDesc.Width != stream->width || texture->stubDesc.Height != stream->height || texture->stubDesc.Format != textureFormat(stream->format))
+        return RS_ERROR_INVALID_PARAMETERS;
+    texture->stubSync();
+
+    ++lb.results.sends;
+    const auto it = lb.outstanding.find(uint64_t(sendData->tTracked));
+    if (it == lb.outstanding.end())
+        return RS_ERROR_SUCCESS; // Dropped already
+    if (--it->second.streamsRemaining == 0)
+    {
+        const Clock::time_point now = Clock::now();
+        lb.results.latencyMs.push_back(std::chrono::duration<double, std::milli>(now - it->second.requested).count());
+        lb.results.lastCompletion = now;
+        ++lb.results.completed;
+        lb.outstanding.erase(it);
+    }
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_logToD3(const char* str)
+{
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    logMessage(lb, str);
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_sendProfilingData(ProfilingEntry* entries, int count)
+{
+    StubHeapScope heapScope;
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    lb.results.profiling.clear();
+    for (int i = 0; i < count; ++i)
+        lb.results.profiling.emplace_back(entries[i].name, entries[i].value);
+    return RS_ERROR_SUCCESS;
+}
+
+RS_ERROR rs_setNewStatusMessage(const char* msg)
+{
+    StubHeapScope heapScope;
+    Loopback& lb = loopback();
+    std::lock_guard<std::mutex> lock(lb.mutex);
+    lb.results.status = msg ? msg : "";
+    if (lb.scenario.verbose)
+        std::fprintf(stderr, "[d3 status] %s\n", lb.results.status.c_str());
+    return RS_ERROR_SUCCESS;
+}
+
+} // extern "C"
+
+void* renderStreamStubProc(const char* name)
+{
+#define STUB_PROC(FUNC_NAME) { #FUNC_NAME, reinterpret_cast<void*>(&FUNC_NAME) }
+    static const std::unordered_map<std::string, void*> procs = {
+        STUB_PROC(rs_registerLoggingFunc),
+        STUB_PROC(rs_registerErrorLoggingFunc),
+        STUB_PROC(rs_initialise),
+        STUB_PROC(rs_initialiseGpGpuWithDX11Device),
+        STUB_PROC(rs_shutdown),
+        STUB_PROC(rs_saveSchema),
+        STUB_PROC(rs_setSchema),
+        STUB_PROC(rs_getStreams),
+        STUB_PROC(rs_awaitFrameData),
+        STUB_PROC(rs_getFrameParameters),
+        STUB_PROC(rs_getFrameImageData),
+        STUB_PROC(rs_getFrameImage),
+        STUB_PROC(rs_getFrameText),
+        STUB_PROC(rs_getFrameCamera),
+        STUB_PROC(rs_sendFrame),
+        STUB_PROC(rs_logToD3),
+        STUB_PROC(rs_sendProfilingData),
+        STUB_PROC(rs_setNewStatusMessage),
+    };
+#undef STUB_PROC
+    const auto it = procs.find(name);
+    return it == procs.end() ? nullptr : it->second;
+}
@@ -0,0 +1,48 @@
+// Pixel helpers shared by the stand-ins
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+inline float stubHalfToFloat(uint16_t h)
+{
+    const uint32_t sign = uint32_t(h & 0x8000) << 16;
+    const uint32_t exponent = (h >> 10) & 0x1f;
+    const uint32_t mantissa = h & 0x3ff;
+    if (exponent == 0)
+    {
+        const float value = std::ldexp(float(mantissa), -24);
+        return sign ? -value : value;
+    }
+    uint32_t bits = sign | (exponent == 0x1f ? 0x7f800000 | (mantissa << 13) : ((exponent + 112) << 23) | (mantissa << 13));
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline uint16_t stubFloatToHalf(float f)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+    if (std::isnan(f))
+        return uint16_t(sign | 0x7e00);
+    const float magnitude = std::fabs(f);
+    if (magnitude >= 65520.f)
+        return uint16_t(sign | 0x7c00);
+    if (magnitude < 6.103515625e-05f) // Subnormal
+        return uint16_t(sign | uint16_t(std::lrint(magnitude * 16777216.f)));
+    int exponent;
+    const float mantissa = std::frexp(magnitude, &exponent); // [0.5, 1)
+    const uint32_t rounded = uint32_t(std::lrint(mantissa * 2048.f)); // 11 bits, may round up to 2048
+    return uint16_t(sign | ((uint32_t(exponent + 14) << 10) + (rounded - 1024)));
+}
+
+// D3D UNORM conversions: saturate, scale and round to nearest even
+inline uint32_t stubFloatToUnorm(float f, float max)
+{
+    const float saturated = f > 0.f ? (f < 1.f ? f : 1.f) : 0.f;
+    return uint32_t(std::lrint(saturated * max));
+}
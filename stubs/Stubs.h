@@ -0,0 +1,112 @@
+// Controls and counters for the stand-ins the benchmark links the app against in place of d3, the GPU and
+// the NvVFX SDK: the RenderStream loopback (RenderStreamStub.cpp), the NvVFX and NvCVImage stand-ins
+// (NvVFXStub.cpp), the CUDA event and interop stand-in (CudaStub.cpp) and the Win32 and D3D11 stand-ins (D3D11Stub.cpp).
+
+#pragma once
+
+#include "win32/windows.h"
+#include "../renderstream/d3renderstream.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct StubCounters
+{
+    std::atomic<uint64_t> texturesCreated{ 0 };
+    std::atomic<uint64_t> textureBytes{ 0 }; // Total allocated for textures
+    std::atomic<uint64_t> imagesAllocated{ 0 }; // NvCVImage buffers
+    std::atomic<uint64_t> imageBytes{ 0 };
+    std::atomic<uint64_t> mapCalls{ 0 }; // NvCVImage_MapResource and cuGraphicsMapResources
+    std::atomic<uint64_t> mappedResources{ 0 }; // By those calls, one each for NvCVImage_MapResource
+    std::atomic<uint64_t> unmapCalls{ 0 }; // NvCVImage_UnmapResource and cuGraphicsUnmapResources
+    std::atomic<uint64_t> transfers{ 0 }; // NvCVImage_Transfer
+    std::atomic<uint64_t> effectLoads{ 0 };
+    std::atomic<uint64_t> effectRuns{ 0 };
+    std::atomic<uint64_t> draws{ 0 };
+    std::atomic<uint64_t> dispatches{ 0 };
+};
+
+inline StubCounters& stubCounters()
+{
+    static StubCounters counters;
+    return counters;
+}
+
+// Whether Cuda has been initialised, as the runtime does when the NvVFX stand-in's NvVFX_CudaStreamCreate first
+// creates a stream; until then the Cuda stand-in's calls fail with CUDA_ERROR_NOT_INITIALIZED, as the driver API's do
+inline std::atomic<bool>& stubCudaInitialised()
+{
+    static std::atomic<bool> initialised{ false };
+    return initialised;
+}
+
+// Heap allocations made by the stand-ins stand for work d3 or the GPU would do, so the benchmark only counts
+// allocations made outside a StubHeapScope
+inline int& stubHeapDepth()
+{
+    thread_local int depth = 0;
+    return depth;
+}
+
+struct StubHeapScope
+{
+    StubHeapScope() { ++stubHeapDepth(); }
+    ~StubHeapScope() { --stubHeapDepth(); }
+    StubHeapScope(const StubHeapScope&) = delete;
+    StubHeapScope& operator=(const StubHeapScope&) = delete;
+};
+
+// How long the NvVFX stand-in's NvVFX_Run takes on its stream, as the GPU would, and how long NvVFX_Load blocks
+void nvvfxStubSetDelays(std::chrono::microseconds run, std::chrono::microseconds load);
+
+// What the RenderStream loopback asks the app for
+struct LoopbackScenario
+{
+    struct Size
+    {
+        uint32_t width;
+        uint32_t height;
+    };
+
+    uint64_t frames = 1000; // Frame requests to make before asking the app to quit
+    std::vector<Size> sizes = { { 640, 360 } }; // Image parameter sizes, in turn
+    uint64_t framesPerSize = 1; // Frames before moving to the next size
+    std::vector<uint32_t> scenes = { 0 }; // Scenes to request, in turn
+    uint64_t framesPerScene = 1; // Frames before moving to the next scene
+    uint64_t framesPerImage = 1; // Frames image parameters keep the same image id for, as for a still
+    uint64_t framesPerSetting = 0; // If set, numeric parameters switch between their default and another value this often
+    uint32_t streams = 1;
+    uint64_t consumeEvery = 1; // Only every this many frames has camera data for the streams, so is sent anything
+    Size streamSize = { 0, 0 }; // 0 to use the first image parameter size
+    RSPixelFormat streamFormat = RS_FMT_BGRA8; // Of every stream, frames sent must be in the matching texture format
+    RSPixelFormat imageFormat = RS_FMT_BGRA8; // Of every image parameter, fetched into textures of the matching format
+    uint64_t streamChangeEvery = 0; // If set, the streams change this often, the last one switching between full and half size
+    uint32_t maxOutstanding = 1; // Frames requested but not yet sent to every stream before the loopback waits, as d3 would
+    std::chrono::milliseconds dropAfter{ 1000 }; // How long a frame may go unsent before it counts as dropped
+    bool verbose = false; // Print what the app logs to d3
+    std::function<void()> onFirstFrame; // Called as the first frame is requested, after the app has started up
+};
+
+struct LoopbackResults
+{
+    uint64_t requested = 0;
+    uint64_t completed = 0; // Sent to every stream
+    uint64_t dropped = 0;
+    uint64_t sends = 0;
+    uint64_t logMessages = 0; // From rs_logToD3
+    std::chrono::steady_clock::time_point firstRequest;
+    std::chrono::steady_clock::time_point lastCompletion;
+    std::vector<double> latencyMs; // From request until sent to every stream, for every completed frame
+    std::vector<std::pair<std::string, float>> profiling; // As last sent by rs_sendProfilingData
+    std::string status; // As last set by rs_setNewStatusMessage
+};
+
+void loopbackConfigure(const LoopbackScenario& scenario);
+const LoopbackResults& loopbackResults();
+
+// The RenderStream loopback's entry points, by name, for the stand-in GetProcAddress
+void* renderStreamStubProc(const char* name);
@@ -0,0 +1,17 @@
+// Stand-in for DirectXMath.h, see windows.h
+
+#pragma once
+
+namespace DirectX
+{
+    struct XMFLOAT2
+    {
+        float x, y;
+        constexpr XMFLOAT2(float x, float y) : x(x), y(y) {}
+    };
+    struct XMFLOAT3
+    {
+        float x, y, z;
+        constexpr XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+    };
+}
@@ -0,0 +1,3 @@
+// Stand-in for the compiled shader, see ../windows.h. The D3D11 stand-in runs the CPU version of the shader it names.
+
+const unsigned char MatteShaderBlob[] = "InputShader";
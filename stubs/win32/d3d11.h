@@ -0,0 +1,234 @@
+// Stand-in for the D3D11 API the app uses, see windows.h. Resources live in host memory and draws and
+// dispatches run CPU versions of the app's shaders, named by the Generated_Code stand-ins. Objects are
+// reference counted like COM objects.
+
+#pragma once
+
+#include "windows.h"
+#include "dxgitype.h"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum D3D11_USAGE { D3D11_USAGE_DEFAULT = 0, D3D11_USAGE_IMMUTABLE = 1, D3D11_USAGE_DYNAMIC = 2, D3D11_USAGE_STAGING = 3 };
+enum D3D11_BIND_FLAG
+{
+    D3D11_BIND_VERTEX_BUFFER = 0x1,
+    D3D11_BIND_INDEX_BUFFER = 0x2,
+    D3D11_BIND_CONSTANT_BUFFER = 0x4,
+    D3D11_BIND_SHADER_RESOURCE = 0x8,
+    D3D11_BIND_RENDER_TARGET = 0x20,
+    D3D11_BIND_DEPTH_STENCIL = 0x40,
+    D3D11_BIND_UNORDERED_ACCESS = 0x80,
+};
+enum D3D11_RESOURCE_MISC_FLAG { D3D11_RESOURCE_MISC_SHARED = 0x2, D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS = 0x20 };
+enum D3D11_SRV_DIMENSION { D3D11_SRV_DIMENSION_TEXTURE2D = 4 };
+enum D3D11_RTV_DIMENSION { D3D11_RTV_DIMENSION_TEXTURE2D = 4 };
+enum D3D11_DSV_DIMENSION { D3D11_DSV_DIMENSION_TEXTURE2D = 3 };
+enum D3D11_UAV_DIMENSION { D3D11_UAV_DIMENSION_BUFFER = 1, D3D11_UAV_DIMENSION_TEXTURE2D = 4 };
+enum D3D11_BUFFER_UAV_FLAG { D3D11_BUFFER_UAV_FLAG_RAW = 0x1 };
+enum D3D11_FORMAT_SUPPORT { D3D11_FORMAT_SUPPORT_TYPED_UNORDERED_ACCESS_VIEW = 0x2000000 };
+enum D3D11_CLEAR_FLAG { D3D11_CLEAR_DEPTH = 0x1, D3D11_CLEAR_STENCIL = 0x2 };
+enum D3D11_INPUT_CLASSIFICATION { D3D11_INPUT_PER_VERTEX_DATA = 0 };
+enum D3D11_PRIMITIVE_TOPOLOGY { D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5 };
+enum D3D_DRIVER_TYPE { D3D_DRIVER_TYPE_HARDWARE = 1 };
+enum D3D_FEATURE_LEVEL { D3D_FEATURE_LEVEL_11_0 = 0xb000 };
+enum D3D11_CREATE_DEVICE_FLAG { D3D11_CREATE_DEVICE_DEBUG = 0x2 };
+
+#define D3D11_SDK_VERSION 7
+#define D3D11_APPEND_ALIGNED_ELEMENT 0xffffffff
+
+struct D3D11_TEXTURE2D_DESC
+{
+    UINT Width;
+    UINT Height;
+    UINT MipLevels;
+    UINT ArraySize;
+    DXGI_FORMAT Format;
+    DXGI_SAMPLE_DESC SampleDesc;
+    D3D11_USAGE Usage;
+    UINT BindFlags;
+    UINT CPUAccessFlags;
+    UINT MiscFlags;
+};
+struct D3D11_TEX2D_SRV { UINT MostDetailedMip; UINT MipLevels; };
+struct D3D11_SHADER_RESOURCE_VIEW_DESC { DXGI_FORMAT Format; D3D11_SRV_DIMENSION ViewDimension; D3D11_TEX2D_SRV Texture2D; };
+struct D3D11_TEX2D_RTV { UINT MipSlice; };
+struct D3D11_RENDER_TARGET_VIEW_DESC { DXGI_FORMAT Format; D3D11_RTV_DIMENSION ViewDimension; D3D11_TEX2D_RTV Texture2D; };
+struct D3D11_TEX2D_DSV { UINT MipSlice; };
+struct D3D11_DEPTH_STENCIL_VIEW_DESC { DXGI_FORMAT Format; D3D11_DSV_DIMENSION ViewDimension; UINT Flags; D3D11_TEX2D_DSV Texture2D; };
+struct D3D11_BUFFER_UAV { UINT FirstElement; UINT NumElements; UINT Flags; };
+struct D3D11_TEX2D_UAV { UINT MipSlice; };
+struct D3D11_UNORDERED_ACCESS_VIEW_DESC
+{
+    DXGI_FORMAT Format;
+    D3D11_UAV_DIMENSION ViewDimension;
+    union
+    {
+        D3D11_BUFFER_UAV Buffer;
+        D3D11_TEX2D_UAV Texture2D;
+    };
+};
+struct D3D11_SUBRESOURCE_DATA { const void* pSysMem; UINT SysMemPitch; UINT SysMemSlicePitch; };
+struct D3D11_BUFFER_DESC { UINT ByteWidth; D3D11_USAGE Usage; UINT BindFlags; UINT CPUAccessFlags; UINT MiscFlags; UINT StructureByteStride; };
+struct CD3D11_BUFFER_DESC : D3D11_BUFFER_DESC
+{
+    CD3D11_BUFFER_DESC(UINT byteWidth, UINT bindFlags, D3D11_USAGE usage = D3D11_USAGE_DEFAULT, UINT cpuAccessFlags = 0, UINT miscFlags = 0, UINT structureByteStride = 0)
+    {
+        ByteWidth = byteWidth;
+        Usage = usage;
+        BindFlags = bindFlags;
+        CPUAccessFlags = cpuAccessFlags;
+        MiscFlags = miscFlags;
+        StructureByteStride = structureByteStride;
+    }
+};
+struct D3D11_INPUT_ELEMENT_DESC
+{
+    const char* SemanticName;
+    UINT SemanticIndex;
+    DXGI_FORMAT Format;
+    UINT InputSlot;
+    UINT AlignedByteOffset;
+    D3D11_INPUT_CLASSIFICATION InputSlotClass;
+    UINT InstanceDataStepRate;
+};
+struct D3D11_VIEWPORT { FLOAT TopLeftX; FLOAT TopLeftY; FLOAT Width; FLOAT Height; FLOAT MinDepth; FLOAT MaxDepth; };
+struct D3D11_BOX { UINT left; UINT top; UINT front; UINT right; UINT bottom; UINT back; };
+
+struct IUnknown
+{
+    virtual ~IUnknown() = default;
+    unsigned long AddRef() { return ++m_refCount; }
+    unsigned long Release()
+    {
+        const unsigned long count = --m_refCount;
+        if (count == 0)
+            delete this;
+        return count;
+    }
+
+private:
+    std::atomic<unsigned long> m_refCount{ 1 };
+};
+
+struct ID3D11DeviceChild : IUnknown {};
+struct ID3D11Resource : ID3D11DeviceChild
+{
+    // Waits for Cuda stream work that still uses the resource once it has been unmapped, as D3D does when
+    // it next uses a resource shared with Cuda. Called before the host touches the resource.
+    void stubSync()
+    {
+        if (!stubPending)
+            return;
+        std::function<void()> pending = std::move(stubPending);
+        stubPending = nullptr;
+        pending();
+    }
+    std::function<void()> stubPending;
+};
+
+struct ID3D11Texture2D : ID3D11Resource
+{
+    void GetDesc(D3D11_TEXTURE2D_DESC* desc) { *desc = stubDesc; }
+
+    // Host memory the texture lives in, rows of (stubPitch) bytes
+    D3D11_TEXTURE2D_DESC stubDesc;
+    UINT stubPitch = 0;
+    std::vector<uint8_t> stubData;
+};
+
+struct ID3D11Buffer : ID3D11Resource
+{
+    std::vector<uint8_t> stubData;
+};
+
+struct ID3D11View : ID3D11DeviceChild
+{
+    ~ID3D11View() override
+    {
+        if (stubTexture)
+            stubTexture->Release();
+        if (stubBuffer)
+            stubBuffer->Release();
+    }
+    // Whichever the view is of, referenced by the view
+    ID3D11Texture2D* stubTexture = nullptr;
+    ID3D11Buffer* stubBuffer = nullptr;
+};
+struct ID3D11ShaderResourceView : ID3D11View {};
+struct ID3D11RenderTargetView : ID3D11View {};
+struct ID3D11DepthStencilView : ID3D11View {};
+struct ID3D11UnorderedAccessView : ID3D11View {};
+
+struct ID3D11ClassLinkage;
+struct ID3D11Shader : ID3D11DeviceChild
+{
+    std::string stubName; // Which of the app's shaders this is
+};
+struct ID3D11VertexShader : ID3D11Shader {};
+struct ID3D11PixelShader : ID3D11Shader {};
+struct ID3D11ComputeShader : ID3D11Shader {};
+struct ID3D11InputLayout : ID3D11DeviceChild {};
+
+struct ID3D11DeviceContext : IUnknown
+{
+    ~ID3D11DeviceContext() override;
+
+    void OMSetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* renderTargetViews, ID3D11DepthStencilView* depthStencilView);
+    void ClearRenderTargetView(ID3D11RenderTargetView* renderTargetView, const FLOAT colour[4]);
+    void ClearDepthStencilView(ID3D11DepthStencilView* depthStencilView, UINT clearFlags, FLOAT depth, BYTE stencil);
+    void RSSetViewports(UINT numViewports, const D3D11_VIEWPORT* viewports);
+    void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box, const void* data, UINT rowPitch, UINT depthPitch);
+    void CopyResource(ID3D11Resource* destination, ID3D11Resource* source);
+    void IASetVertexBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* vertexBuffers, const UINT* strides, const UINT* offsets);
+    void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology);
+    void IASetInputLayout(ID3D11InputLayout* inputLayout);
+    void VSSetShader(ID3D11VertexShader* shader, void* const* classInstances, UINT numClassInstances);
+    void PSSetShader(ID3D11PixelShader* shader, void* const* classInstances, UINT numClassInstances);
+    void PSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* constantBuffers);
+    void PSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* shaderResourceViews);
+    void CSSetShader(ID3D11ComputeShader* shader, void* const* classInstances, UINT numClassInstances);
+    void CSSetConstantBuffers(UINT startSlot, UINT numBuffers, ID3D11Buffer* const* constantBuffers);
+    void CSSetShaderResources(UINT startSlot, UINT numViews, ID3D11ShaderResourceView* const* shaderResourceViews);
+    void CSSetUnorderedAccessViews(UINT startSlot, UINT numViews, ID3D11UnorderedAccessView* const* unorderedAccessViews, const UINT* initialCounts);
+    void Draw(UINT vertexCount, UINT startVertexLocation);
+    void Dispatch(UINT threadGroupCountX, UINT threadGroupCountY, UINT threadGroupCountZ);
+
+    // Bound state, with a reference held on each
+    static constexpr UINT STUB_SLOTS = 8;
+    ID3D11RenderTargetView* stubRenderTarget = nullptr;
+    D3D11_VIEWPORT stubViewport = {};
+    ID3D11PixelShader* stubPixelShader = nullptr;
+    ID3D11ComputeShader* stubComputeShader = nullptr;
+    ID3D11Buffer* stubPixelConstants[STUB_SLOTS] = {};
+    ID3D11Buffer* stubComputeConstants[STUB_SLOTS] = {};
+    ID3D11ShaderResourceView* stubPixelResources[STUB_SLOTS] = {};
+    ID3D11ShaderResourceView* stubComputeResources[STUB_SLOTS] = {};
+    ID3D11UnorderedAccessView* stubComputeUavs[STUB_SLOTS] = {};
+};
+
+struct ID3D11Device : IUnknown
+{
+    HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Texture2D** texture);
+    HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* initialData, ID3D11Buffer** buffer);
+    HRESULT CreateShaderResourceView(ID3D11Resource* resource, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc, ID3D11ShaderResourceView** view);
+    HRESULT CreateRenderTargetView(ID3D11Resource* resource, const D3D11_RENDER_TARGET_VIEW_DESC* desc, ID3D11RenderTargetView** view);
+    HRESULT CreateDepthStencilView(ID3D11Resource* resource, const D3D11_DEPTH_STENCIL_VIEW_DESC* desc, ID3D11DepthStencilView** view);
+    HRESULT CreateUnorderedAccessView(ID3D11Resource* resource, const D3D11_UNORDERED_ACCESS_VIEW_DESC* desc, ID3D11UnorderedAccessView** view);
+    HRESULT CreateVertexShader(const void* bytecode, size_t bytecodeLength, ID3D11ClassLinkage* classLinkage, ID3D11VertexShader** shader);
+    HRESULT CreatePixelShader(const void* bytecode, size_t bytecodeLength, ID3D11ClassLinkage* classLinkage, ID3D11PixelShader** shader);
+    HRESULT CreateComputeShader(const void* bytecode, size_t bytecodeLength, ID3D11ClassLinkage* classLinkage, ID3D11ComputeShader** shader);
+    HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* elements, UINT numElements, const void* bytecode, size_t bytecodeLength, ID3D11InputLayout** inputLayout);
+    HRESULT CheckFormatSupport(DXGI_FORMAT format, UINT* formatSupport);
+};
+
+struct IDXGIAdapter;
+HRESULT D3D11CreateDevice(IDXGIAdapter* adapter, D3D_DRIVER_TYPE driverType, HMODULE software, UINT flags, const D3D_FEATURE_LEVEL* featureLevels, UINT numFeatureLevels,
+    UINT sdkVersion, ID3D11Device** device, D3D_FEATURE_LEVEL* featureLevel, ID3D11DeviceContext** immediateContext);
+
+// Bytes per texel of the formats the stand-in supports, 0 for any other
+UINT stubFormatBytes(DXGI_FORMAT format);
@@ -0,0 +1,3 @@
+// Stand-in for d3dcompiler.h, see windows.h. Shaders are compiled ahead of time; see Generated_Code.
+
+#pragma once
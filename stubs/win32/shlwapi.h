@@ -0,0 +1,7 @@
+// Stand-in for shlwapi.h, see windows.h
+
+#pragma once
+
+#include "windows.h"
+
+BOOL PathRemoveFileSpec(TCHAR* path);
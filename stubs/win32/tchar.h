@@ -0,0 +1,7 @@
+// Stand-in for tchar.h, see windows.h
+
+#pragma once
+
+#include "windows.h"
+
+int _tcscat_s(TCHAR* dest, size_t size, const TCHAR* src);
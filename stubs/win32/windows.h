@@ -0,0 +1,59 @@
+// Stand-in for the parts of the Windows API the app uses, so it can be built for the benchmark on other
+// platforms. Implemented in ../D3D11Stub.cpp; GetProcAddress resolves the RenderStream stand-in's functions.
+
+#pragma once
+
+#define _WINDOWS_ // Keeps the NvVFX headers from including the real one
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#define __declspec(x)
+#define __cdecl
+#define WINAPI
+
+typedef void* HMODULE;
+typedef void* HANDLE;
+typedef void* HKEY;
+typedef long HRESULT;
+typedef long LONG;
+typedef unsigned long DWORD;
+typedef unsigned char BYTE;
+typedef BYTE* LPBYTE;
+typedef unsigned int UINT;
+typedef int BOOL;
+typedef float FLOAT;
+typedef char TCHAR; // UNICODE isn't defined for the benchmark
+typedef const char* LPCTSTR;
+
+#define TEXT(x) x
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define ERROR_SUCCESS 0L
+#define HKEY_CURRENT_USER ((HKEY)(uintptr_t)0x80000001)
+#define KEY_READ 0x20019
+#define LOAD_LIBRARY_SEARCH_DLL_LOAD_DIR 0x100
+#define LOAD_LIBRARY_SEARCH_APPLICATION_DIR 0x200
+#define LOAD_LIBRARY_SEARCH_SYSTEM32 0x800
+#define LOAD_LIBRARY_SEARCH_USER_DIRS 0x400
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+LONG RegOpenKeyEx(HKEY key, LPCTSTR subKey, DWORD options, DWORD desired, HKEY* result);
+LONG RegQueryValueEx(HKEY key, LPCTSTR valueName, DWORD* reserved, DWORD* type, LPBYTE data, DWORD* dataSize);
+HMODULE LoadLibraryEx(LPCTSTR fileName, HANDLE file, DWORD flags);
+HMODULE LoadLibrary(LPCTSTR fileName);
+void* GetProcAddress(HMODULE module, const char* procName);
+
+inline char* _strdup(const char* s)
+{
+    const size_t size = strlen(s) + 1;
+    char* copy = static_cast<char*>(malloc(size));
+    if (copy)
+        memcpy(copy, s, size);
+    return copy;
+}
@@ -0,0 +1,76 @@
+// Stand-in for Microsoft::WRL::ComPtr, see windows.h. Like the real one, GetAddressOf doesn't release what it held.
+
+#pragma once
+
+#include <cstddef>
+
+namespace Microsoft
+{
+    namespace WRL
+    {
+        template <typename T>
+        class ComPtr
+        {
+        public:
+            ComPtr() = default;
+            ComPtr(std::nullptr_t) {}
+            ComPtr(T* p) : m_p(p) { addRef(); }
+            ComPtr(const ComPtr& other) : m_p(other.m_p) { addRef(); }
+            ComPtr(ComPtr&& other) noexcept : m_p(other.m_p) { other.m_p = nullptr; }
+            ~ComPtr() { release(); }
+
+            ComPtr& operator=(const ComPtr& other)
+            {
+                if (other.m_p != m_p)
+                {
+                    release();
+                    m_p = other.m_p;
+                    addRef();
+                }
+                return *this;
+            }
+            ComPtr& operator=(ComPtr&& other) noexcept
+            {
+                if (&other != this)
+                {
+                    release();
+                    m_p = other.m_p;
+                    other.m_p = nullptr;
+                }
+                return *this;
+            }
+            ComPtr& operator=(std::nullptr_t)
+            {
+                release();
+                return *this;
+            }
+
+            T* Get() const { return m_p; }
+            T* operator->() const { return m_p; }
+            T* const* GetAddressOf() const { return &m_p; }
+            T** GetAddressOf() { return &m_p; }
+            T** ReleaseAndGetAddressOf()
+            {
+                release();
+                return &m_p;
+            }
+            void Reset() { release(); }
+            explicit operator bool() const { return m_p != nullptr; }
+
+        private:
+            void addRef()
+            {
+                if (m_p)
+                    m_p->AddRef();
+            }
+            void release()
+            {
+                if (m_p)
+                    m_p->Release();
+                m_p = nullptr;
+            }
+
+            T* m_p = nullptr;
+        };
+    }
+}